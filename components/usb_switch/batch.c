@@ -0,0 +1,129 @@
+/*
+	List of the operations sent to the transmitter at once
+
+	This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+	Unless required by applicable law or agreed to in writing, this
+	software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+	CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "esp_log.h"
+#include "cJSON.h"
+
+#include "batch.h"
+#include "channel.h"
+
+static const char *TAG = "BATCH";
+
+// Upper limit of delay_ms
+#define BATCH_DELAY_MAX 60000
+
+static esp_err_t parse_operation(const cJSON *operation, char *path, size_t path_len, TX_COMMAND_t *command) {
+	const cJSON *channel = cJSON_GetObjectItem(operation, "channel");
+	const cJSON *state = cJSON_GetObjectItem(operation, "state");
+	const cJSON *delay_ms = cJSON_GetObjectItem(operation, "delay_ms");
+	const cJSON *repeats = cJSON_GetObjectItem(operation, "repeats");
+	if (!cJSON_IsString(state)) return ESP_ERR_INVALID_ARG;
+
+	// Build the same path as HTTP and MQTT
+	int len;
+	if (cJSON_IsString(channel)) {
+		len = snprintf(path, path_len, "%s/%s", channel->valuestring, state->valuestring);
+	} else if (cJSON_IsNumber(channel)) {
+		len = snprintf(path, path_len, "%d/%s", channel->valueint, state->valuestring);
+	} else {
+		return ESP_ERR_INVALID_ARG;
+	}
+	if (len < path_len && cJSON_IsNumber(repeats)) {
+		len += snprintf(path + len, path_len - len, ":%d", repeats->valueint);
+	}
+	if (len >= path_len) return ESP_ERR_NOT_FOUND;
+
+	esp_err_t err = channel_command(path, command);
+	if (err != ESP_OK) return err;
+	if (delay_ms != NULL) {
+		if (!cJSON_IsNumber(delay_ms) || delay_ms->valueint < 0 || delay_ms->valueint > BATCH_DELAY_MAX) return ESP_ERR_INVALID_ARG;
+		command->delay_ms = delay_ms->valueint;
+	}
+	// Keep the order and all the operations
+	command->channel = -1;
+	return ESP_OK;
+}
+
+esp_err_t batch_parse(const char *json, BATCH_t *batch) {
+	memset(batch, 0, sizeof(BATCH_t));
+	cJSON *root = cJSON_Parse(json);
+	if (!cJSON_IsArray(root) || cJSON_GetArraySize(root) == 0 || cJSON_GetArraySize(root) > BATCH_MAX) {
+		ESP_LOGE(TAG, "Not a list of 1 to %d operations", BATCH_MAX);
+		cJSON_Delete(root);
+		return ESP_ERR_INVALID_ARG;
+	}
+
+	esp_err_t err = ESP_OK;
+	const cJSON *operation;
+	cJSON_ArrayForEach(operation, root) {
+		int index = batch->count;
+		err = parse_operation(operation, batch->path[index], sizeof(batch->path[index]), &batch->commands[index]);
+		if (err != ESP_OK) {
+			ESP_LOGE(TAG, "operation %d [%s] fail (%s)", index, batch->path[index], esp_err_to_name(err));
+			batch->failed = index;
+			break;
+		}
+		batch->count++;
+	}
+	cJSON_Delete(root);
+	return err;
+}
+
+void batch_run(BATCH_t *batch) {
+	// Each result is stored through the context of the command
+	QueueHandle_t reply = xQueueCreate(BATCH_MAX, sizeof(TX_RESULT_t));
+	if (reply == NULL) {
+		for (int index=0;index<batch->count;index++) batch->results[index].status = ESP_ERR_NO_MEM;
+		return;
+	}
+	int queued = 0;
+	for (int index=0;index<batch->count;index++) {
+		TX_COMMAND_t *command = &batch->commands[index];
+		command->reply = reply;
+		command->context = &batch->results[index];
+		esp_err_t err = transmitter_send(command, portMAX_DELAY);
+		if (err != ESP_OK) {
+			batch->results[index].status = err;
+			continue;
+		}
+		queued++;
+	}
+	for (int i=0;i<queued;i++) {
+		TX_RESULT_t result;
+		xQueueReceive(reply, &result, portMAX_DELAY);
+		*(TX_RESULT_t *)result.context = result;
+	}
+	vQueueDelete(reply);
+}
+
+char *batch_summary(const BATCH_t *batch) {
+	cJSON *root = cJSON_CreateObject();
+	cJSON *results = cJSON_AddArrayToObject(root, "results");
+	int ok = 0;
+	for (int index=0;index<batch->count;index++) {
+		const TX_RESULT_t *result = &batch->results[index];
+		if (result->status == ESP_OK) ok++;
+		cJSON *item = cJSON_CreateObject();
+		cJSON_AddStringToObject(item, "path", batch->path[index]);
+		cJSON_AddStringToObject(item, "status", esp_err_to_name(result->status));
+		cJSON_AddNumberToObject(item, "wait_us", result->wait_us);
+		cJSON_AddNumberToObject(item, "air_us", result->air_us);
+		cJSON_AddItemToArray(results, item);
+	}
+	cJSON_AddNumberToObject(root, "count", batch->count);
+	cJSON_AddNumberToObject(root, "ok", ok);
+	char *text = cJSON_PrintUnformatted(root);
+	cJSON_Delete(root);
+	return text;
+}
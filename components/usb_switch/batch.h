@@ -0,0 +1,32 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include "esp_err.h"
+#include "transmitter.h"
+
+// Maximum number of the operations in one batch
+#define BATCH_MAX 16
+
+typedef struct {
+	int count;
+	int failed; // Index of the operation batch_parse rejected
+	char path[BATCH_MAX][28]; // <channel>/<state>[:<repeats>]
+	TX_COMMAND_t commands[BATCH_MAX];
+	TX_RESULT_t results[BATCH_MAX];
+} BATCH_t;
+
+// Convert the list of the operations into the commands for the transmitter.
+// [{"channel":"usb3","state":"on","delay_ms":500,"repeats":3}, ...]
+// channel is the name or the index. delay_ms and repeats are optional.
+// delay_ms is the silence after the previous operation.
+// Returns the error of channel_command for the operation at failed, or ESP_ERR_INVALID_ARG for a malformed list.
+esp_err_t batch_parse(const char *json, BATCH_t *batch);
+
+// Queue all the commands in order and wait for all the results.
+// The commands of a batch are never coalesced, so the operations for the same channel are all sent.
+void batch_run(BATCH_t *batch);
+
+// Summary of the results in JSON. The caller must free it.
+char *batch_summary(const BATCH_t *batch);
+
+#endif /* BATCH_H */
@@ -0,0 +1,442 @@
+/*
+	Table of the RF codes of the USB switches
+
+	This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+	Unless required by applicable law or agreed to in writing, this
+	software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+	CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <inttypes.h>
+#include <string.h>
+#include <ctype.h>
+#include "esp_log.h"
+#include "esp_crc.h"
+#include "nvs.h"
+
+#include "channel.h"
+
+static const char *TAG = "CHANNEL";
+
+// All the channels are stored as one blob
+#define CHANNEL_NAMESPACE "storage"
+#define CHANNEL_KEY "channels"
+
+// The raw codes are stored as another blob, only when a channel has learned one
+#define RAW_KEY "rawcodes"
+#define RAW_VERSION 1
+
+// Increment when CHANNEL_t is changed.
+// Version 1 had no pulse_length, which was the padding of RF_CODE_t and always 0.
+// Version 2 had no repeats. The channels were 4 bytes shorter.
+#define CHANNEL_VERSION 3
+#define CHANNEL_VERSION_MIN 1
+#define CHANNEL_V2_SIZE offsetof(CHANNEL_t, repeats)
+_Static_assert(sizeof(RF_CODE_t) == 8, "RF_CODE_t must keep the layout of the version 1");
+
+typedef struct {
+	uint16_t version;
+	uint16_t count; // Number of the channels following the header
+	uint32_t crc; // CRC32 of the channels
+} CHANNEL_HEADER_t;
+
+typedef struct {
+	CHANNEL_HEADER_t header;
+	CHANNEL_t channels[CONFIG_USB_SWITCH_CHANNEL_MAX];
+} CHANNEL_RECORD_t;
+
+typedef struct {
+	CHANNEL_HEADER_t header;
+	RF_RAW_CODE_t raws[CONFIG_USB_SWITCH_CHANNEL_MAX][2]; // Indexed by the channel and the state
+} RAW_RECORD_t;
+
+// RAM copy of the blob shared by all the tasks
+static CHANNEL_RECORD_t s_record;
+static CHANNEL_t *s_channels = s_record.channels;
+static int s_nchannel = 0;
+static bool s_loaded = false;
+static RAW_RECORD_t s_raw_record;
+
+// Frames encoded in advance, so a command only hands a pointer to the transmitter
+static RF_WAVEFORM_t s_waveforms[CONFIG_USB_SWITCH_CHANNEL_MAX][2];
+
+// Indexes of the named channels sorted by the name, so channel_find does not scan the table
+static uint8_t s_sorted[CONFIG_USB_SWITCH_CHANNEL_MAX];
+static int s_nsorted = 0;
+
+static uint32_t channel_crc(int count, size_t size) {
+	return esp_crc32_le(0, (const uint8_t *)s_channels, count * size);
+}
+
+static uint32_t raw_crc(int count) {
+	return esp_crc32_le(0, (const uint8_t *)s_raw_record.raws, count * sizeof(s_raw_record.raws[0]));
+}
+
+static bool has_raw(void) {
+	for (int index=0;index<s_nchannel;index++) {
+		for (int state=0;state<2;state++) {
+			if (s_channels[index].code[state].protocol == RFCODEC_PROTOCOL_RAW) return true;
+		}
+	}
+	return false;
+}
+
+// Encode the frame of the code
+static void compile_waveform(int index, int state) {
+	RF_WAVEFORM_t *waveform = &s_waveforms[index][state];
+	free(waveform->symbols);
+	waveform->symbols = NULL;
+	waveform->nsymbol = 0;
+
+	RF_CODE_t *code = &s_channels[index].code[state];
+	if (code->bitlength == 0) return;
+	RF_SYMBOL_t symbols[RFCODEC_RAW_SYMBOL_MAX];
+	int nsymbol;
+	if (code->protocol == RFCODEC_PROTOCOL_RAW) {
+		nsymbol = rfcodec_encode_raw(&s_raw_record.raws[index][state], symbols, RFCODEC_RAW_SYMBOL_MAX);
+	} else {
+		nsymbol = rfcodec_encode(code->protocol, code->pulse_length, code->code, code->bitlength, symbols, RFCODEC_RAW_SYMBOL_MAX);
+	}
+	// Not encodable here. The transmitter backend will report it.
+	if (nsymbol <= 0) return;
+	waveform->symbols = malloc(nsymbol * sizeof(RF_SYMBOL_t));
+	if (waveform->symbols == NULL) return;
+	memcpy(waveform->symbols, symbols, nsymbol * sizeof(RF_SYMBOL_t));
+	waveform->nsymbol = nsymbol;
+}
+
+// Read the raw codes. The raw channels are untaught when the blob is broken.
+static void load_raw(nvs_handle_t my_handle) {
+	CHANNEL_HEADER_t *header = &s_raw_record.header;
+	size_t length = sizeof(s_raw_record);
+	esp_err_t err = nvs_get_blob(my_handle, RAW_KEY, &s_raw_record, &length);
+	if (err != ESP_OK) {
+		ESP_LOGE(TAG, "%s get failed (%s)", RAW_KEY, esp_err_to_name(err));
+	} else if (header->version != RAW_VERSION || header->count > CONFIG_USB_SWITCH_CHANNEL_MAX ||
+		length != sizeof(CHANNEL_HEADER_t) + header->count * sizeof(s_raw_record.raws[0]) ||
+		header->crc != raw_crc(header->count)) {
+		ESP_LOGE(TAG, "%s is broken", RAW_KEY);
+		err = ESP_ERR_INVALID_CRC;
+	}
+	for (int index=0;index<s_nchannel;index++) {
+		for (int state=0;state<2;state++) {
+			RF_CODE_t *code = &s_channels[index].code[state];
+			if (code->protocol != RFCODEC_PROTOCOL_RAW) continue;
+			if (err != ESP_OK || index >= header->count || s_raw_record.raws[index][state].count != code->bitlength) {
+				code->bitlength = 0;
+			}
+		}
+	}
+}
+
+// Check the blob read from NVS
+static bool record_valid(size_t length) {
+	CHANNEL_HEADER_t *header = &s_record.header;
+	if (length < sizeof(CHANNEL_HEADER_t)) return false;
+	if (header->version < CHANNEL_VERSION_MIN || header->version > CHANNEL_VERSION) {
+		ESP_LOGE(TAG, "%s version %u is not supported", CHANNEL_KEY, header->version);
+		return false;
+	}
+	size_t size = header->version < 3 ? CHANNEL_V2_SIZE : sizeof(CHANNEL_t);
+	if (header->count > CONFIG_USB_SWITCH_CHANNEL_MAX ||
+		length != sizeof(CHANNEL_HEADER_t) + header->count * size) {
+		ESP_LOGE(TAG, "%s length %d is wrong", CHANNEL_KEY, (int)length);
+		return false;
+	}
+	if (header->crc != channel_crc(header->count, size)) {
+		ESP_LOGE(TAG, "%s CRC error", CHANNEL_KEY);
+		return false;
+	}
+
+	// Spread the shorter channels of the version 2 from the last one
+	if (size != sizeof(CHANNEL_t)) {
+		for (int index=header->count-1;index>=0;index--) {
+			memmove(&s_channels[index], (uint8_t *)s_channels + index * size, size);
+			memset((uint8_t *)&s_channels[index] + size, 0, sizeof(CHANNEL_t) - size);
+		}
+	}
+	return true;
+}
+
+// Read the six keys written by the old teaching app into the channel 0
+static esp_err_t migrate_legacy(nvs_handle_t my_handle) {
+	uint32_t value[2];
+	uint16_t bitlength[2];
+	uint16_t protocol[2];
+	const char *states[2] = {"Off", "On"};
+	for (int state=0;state<2;state++) {
+		char key[16];
+		snprintf(key, sizeof(key), "Value%s", states[state]);
+		esp_err_t err = nvs_get_u32(my_handle, key, &value[state]);
+		if (err != ESP_OK) return err;
+		snprintf(key, sizeof(key), "Bitlength%s", states[state]);
+		err = nvs_get_u16(my_handle, key, &bitlength[state]);
+		if (err != ESP_OK) return err;
+		snprintf(key, sizeof(key), "Protocol%s", states[state]);
+		err = nvs_get_u16(my_handle, key, &protocol[state]);
+		if (err != ESP_OK) return err;
+	}
+	ESP_LOGW(TAG, "Migrate ValueOn/ValueOff to channel 0");
+	for (int state=0;state<2;state++) {
+		channel_set(0, NULL, state, value[state], bitlength[state], protocol[state], 0);
+	}
+	return ESP_OK;
+}
+
+static int compare_key(const void *key, const void *element) {
+	return strcmp(key, s_channels[*(const uint8_t *)element].name);
+}
+
+static int compare_index(const void *a, const void *b) {
+	int index_a = *(const uint8_t *)a;
+	int index_b = *(const uint8_t *)b;
+	int diff = strcmp(s_channels[index_a].name, s_channels[index_b].name);
+	return diff ? diff : index_a - index_b;
+}
+
+// Rebuild the sorted index when a name has been changed
+static void sort_names(void) {
+	s_nsorted = 0;
+	for (int index=0;index<s_nchannel;index++) {
+		if (s_channels[index].name[0] != '\0') s_sorted[s_nsorted++] = index;
+	}
+	qsort(s_sorted, s_nsorted, sizeof(s_sorted[0]), compare_index);
+}
+
+esp_err_t channel_init(void) {
+	// NVS is read only once
+	if (s_loaded) return ESP_OK;
+	memset(&s_record, 0, sizeof(s_record));
+	s_nchannel = 0;
+
+	// Open NVS
+	nvs_handle_t my_handle;
+	esp_err_t err = nvs_open(CHANNEL_NAMESPACE, NVS_READONLY, &my_handle);
+	if (err == ESP_ERR_NVS_NOT_FOUND) {
+		ESP_LOGW(TAG, "No channel has been taught");
+		s_loaded = true;
+		return ESP_OK;
+	}
+	if (err != ESP_OK) {
+		ESP_LOGE(TAG, "nvs_open error (%s)", esp_err_to_name(err));
+		return err;
+	}
+
+	// Read the table with a single read
+	size_t length = sizeof(s_record);
+	err = nvs_get_blob(my_handle, CHANNEL_KEY, &s_record, &length);
+	bool migrated = false;
+	if (err == ESP_OK) {
+		if (record_valid(length)) {
+			s_nchannel = s_record.header.count;
+		} else {
+			// Never send a broken code. The channels must be taught again.
+			memset(&s_record, 0, sizeof(s_record));
+			migrated = (migrate_legacy(my_handle) == ESP_OK);
+		}
+	} else if (err == ESP_ERR_NVS_NOT_FOUND) {
+		migrated = (migrate_legacy(my_handle) == ESP_OK);
+		err = ESP_OK;
+	} else if (err == ESP_ERR_NVS_INVALID_LENGTH) {
+		ESP_LOGE(TAG, "%s has more than %d channels", CHANNEL_KEY, CONFIG_USB_SWITCH_CHANNEL_MAX);
+		memset(&s_record, 0, sizeof(s_record));
+		err = ESP_OK;
+	} else {
+		ESP_LOGE(TAG, "%s get failed (%s)", CHANNEL_KEY, esp_err_to_name(err));
+	}
+
+	if (has_raw()) load_raw(my_handle);
+
+	// Close NVS
+	nvs_close(my_handle);
+	if (migrated) err = channel_save();
+	s_loaded = (err == ESP_OK);
+
+	sort_names();
+	for (int index=0;index<s_nchannel;index++) {
+		compile_waveform(index, CHANNEL_OFF);
+		compile_waveform(index, CHANNEL_ON);
+		CHANNEL_t *channel = &s_channels[index];
+		ESP_LOGI(TAG, "channel %d [%s] on=%"PRIu32"/%u/%u/%u off=%"PRIu32"/%u/%u/%u repeats=%u", index, channel->name,
+			channel->code[CHANNEL_ON].code, channel->code[CHANNEL_ON].bitlength, channel->code[CHANNEL_ON].protocol, channel->code[CHANNEL_ON].pulse_length,
+			channel->code[CHANNEL_OFF].code, channel->code[CHANNEL_OFF].bitlength, channel->code[CHANNEL_OFF].protocol, channel->code[CHANNEL_OFF].pulse_length, channel->repeats);
+	}
+	return err;
+}
+
+int channel_count(void) {
+	return s_nchannel;
+}
+
+CHANNEL_t *channel_get(int index) {
+	if (index < 0 || index >= s_nchannel) return NULL;
+	return &s_channels[index];
+}
+
+int channel_find(const char *name) {
+	const uint8_t *found = bsearch(name, s_sorted, s_nsorted, sizeof(s_sorted[0]), compare_key);
+	if (found != NULL) {
+		// The same name may be taught to several channels. The smallest index wins.
+		while (found > s_sorted && compare_key(name, found-1) == 0) found--;
+		return *found;
+	}
+
+	// The index number
+	if (*name == '\0') return -1;
+	int index = 0;
+	for (const char *c=name;*c!='\0';c++) {
+		if (!isdigit((unsigned char)*c)) return -1;
+		index = index * 10 + (*c - '0');
+		if (index >= s_nchannel) return -1;
+	}
+	return index;
+}
+
+// Add the channel and set the name
+static esp_err_t channel_add(int index, const char *name, int state) {
+	if (index < 0 || index >= CONFIG_USB_SWITCH_CHANNEL_MAX) return ESP_ERR_INVALID_ARG;
+	if (state != CHANNEL_ON && state != CHANNEL_OFF) return ESP_ERR_INVALID_ARG;
+	if (name != NULL && strlen(name) >= sizeof(s_channels[index].name)) return ESP_ERR_INVALID_SIZE;
+	if (index >= s_nchannel) s_nchannel = index + 1;
+
+	CHANNEL_t *channel = &s_channels[index];
+	if (name != NULL && *name != '\0') {
+		if (strcmp(channel->name, name) == 0) return ESP_OK;
+		strcpy(channel->name, name);
+	} else if (channel->name[0] == '\0') {
+		snprintf(channel->name, sizeof(channel->name), "usb%d", index);
+	} else {
+		return ESP_OK;
+	}
+	sort_names();
+	return ESP_OK;
+}
+
+esp_err_t channel_set(int index, const char *name, int state, uint32_t code, uint8_t bitlength, uint8_t protocol, uint16_t pulse_length) {
+	esp_err_t err = channel_add(index, name, state);
+	if (err != ESP_OK) return err;
+	CHANNEL_t *channel = &s_channels[index];
+	channel->code[state].code = code;
+	channel->code[state].bitlength = bitlength;
+	channel->code[state].protocol = protocol;
+	channel->code[state].pulse_length = pulse_length;
+	compile_waveform(index, state);
+	return ESP_OK;
+}
+
+esp_err_t channel_set_raw(int index, const char *name, int state, const RF_RAW_CODE_t *raw) {
+	if (raw->count == 0) return ESP_ERR_INVALID_ARG;
+	esp_err_t err = channel_add(index, name, state);
+	if (err != ESP_OK) return err;
+	CHANNEL_t *channel = &s_channels[index];
+	channel->code[state].code = 0;
+	channel->code[state].bitlength = raw->count;
+	channel->code[state].protocol = RFCODEC_PROTOCOL_RAW;
+	channel->code[state].pulse_length = 0;
+	s_raw_record.raws[index][state] = *raw;
+	compile_waveform(index, state);
+	return ESP_OK;
+}
+
+esp_err_t channel_set_repeats(int index, int repeats) {
+	if (index < 0 || index >= s_nchannel) return ESP_ERR_INVALID_ARG;
+	if (repeats < 0 || repeats > CHANNEL_REPEATS_MAX) return ESP_ERR_INVALID_ARG;
+	s_channels[index].repeats = repeats;
+	return ESP_OK;
+}
+
+esp_err_t channel_save(void) {
+	// Open NVS
+	nvs_handle_t my_handle;
+	esp_err_t err = nvs_open(CHANNEL_NAMESPACE, NVS_READWRITE, &my_handle);
+	if (err != ESP_OK) {
+		ESP_LOGE(TAG, "nvs_open error (%s)", esp_err_to_name(err));
+		return err;
+	}
+
+	// The raw codes first, so the channels never refer to the raw codes not written yet
+	if (has_raw()) {
+		s_raw_record.header.version = RAW_VERSION;
+		s_raw_record.header.count = s_nchannel;
+		s_raw_record.header.crc = raw_crc(s_nchannel);
+		err = nvs_set_blob(my_handle, RAW_KEY, &s_raw_record, sizeof(CHANNEL_HEADER_t) + s_nchannel * sizeof(s_raw_record.raws[0]));
+		if (err != ESP_OK) {
+			ESP_LOGE(TAG, "%s set failed (%s)", RAW_KEY, esp_err_to_name(err));
+			nvs_close(my_handle);
+			return err;
+		}
+	}
+
+	// Set NVS with a single write, so the ON/OFF pair is never half written
+	s_record.header.version = CHANNEL_VERSION;
+	s_record.header.count = s_nchannel;
+	s_record.header.crc = channel_crc(s_nchannel, sizeof(CHANNEL_t));
+	err = nvs_set_blob(my_handle, CHANNEL_KEY, &s_record, sizeof(CHANNEL_HEADER_t) + s_nchannel * sizeof(CHANNEL_t));
+	if (err != ESP_OK) {
+		ESP_LOGE(TAG, "%s set failed (%s)", CHANNEL_KEY, esp_err_to_name(err));
+	} else {
+		err = nvs_commit(my_handle);
+		if (err != ESP_OK) ESP_LOGE(TAG, "nvs_commit failed (%s)", esp_err_to_name(err));
+	}
+
+	// Close NVS
+	nvs_close(my_handle);
+	return err;
+}
+
+esp_err_t channel_command(const char *path, TX_COMMAND_t *command) {
+	memset(command, 0, sizeof(TX_COMMAND_t));
+
+	// Split the channel and the state
+	char name[sizeof(((CHANNEL_t *)0)->name)];
+	const char *state_name = strrchr(path, '/');
+	int index = 0;
+	if (state_name == NULL) {
+		state_name = path;
+	} else {
+		int name_len = state_name - path;
+		if (name_len >= sizeof(name)) return ESP_ERR_NOT_FOUND;
+		memcpy(name, path, name_len);
+		name[name_len] = '\0';
+		state_name++;
+		index = channel_find(name);
+		if (index < 0) return ESP_ERR_NOT_FOUND;
+	}
+
+	// Number of times to repeat the frame following the state
+	int repeats = 0;
+	int state_len = strlen(state_name);
+	const char *repeats_name = strchr(state_name, ':');
+	if (repeats_name != NULL) {
+		state_len = repeats_name - state_name;
+		char *end;
+		long value = strtol(repeats_name + 1, &end, 10);
+		if (end == repeats_name + 1 || *end != '\0' || value < 1 || value > CHANNEL_REPEATS_MAX) return ESP_ERR_INVALID_ARG;
+		repeats = value;
+	}
+
+	int state;
+	if (state_len == 2 && strncmp(state_name, "on", state_len) == 0) {
+		state = CHANNEL_ON;
+	} else if (state_len == 3 && strncmp(state_name, "off", state_len) == 0) {
+		state = CHANNEL_OFF;
+	} else {
+		return ESP_ERR_NOT_FOUND;
+	}
+
+	CHANNEL_t *channel = channel_get(index);
+	if (channel == NULL || channel->code[state].bitlength == 0) return ESP_ERR_INVALID_STATE;
+	command->code = channel->code[state].code;
+	command->bitlength = channel->code[state].bitlength;
+	command->protocol = channel->code[state].protocol;
+	command->pulse_length = channel->code[state].pulse_length;
+	command->repeats = repeats ? repeats : channel->repeats;
+	command->channel = index;
+	if (command->protocol == RFCODEC_PROTOCOL_RAW) command->raw = &s_raw_record.raws[index][state];
+	if (s_waveforms[index][state].nsymbol) command->waveform = &s_waveforms[index][state];
+	return ESP_OK;
+}
@@ -0,0 +1,60 @@
+#ifndef CHANNEL_H
+#define CHANNEL_H
+
+#include "esp_err.h"
+#include "transmitter.h"
+#include "rfcodec.h"
+
+#define CHANNEL_OFF 0
+#define CHANNEL_ON 1
+
+// Same as the range of CONFIG_RF_TX_REPEAT
+#define CHANNEL_REPEATS_MAX 100
+
+typedef struct {
+	uint32_t code;
+	uint8_t bitlength; // 0 means not taught. The number of the durations for the raw code.
+	uint8_t protocol; // RFCODEC_PROTOCOL_RAW for the raw code
+	uint16_t pulse_length; // Measured at the time of teaching. 0 means the default of the protocol.
+} RF_CODE_t;
+
+typedef struct {
+	char name[16];
+	RF_CODE_t code[2]; // Indexed by CHANNEL_OFF and CHANNEL_ON
+	uint8_t repeats; // Number of times to repeat the frame. 0 means CONFIG_RF_TX_REPEAT.
+	uint8_t reserved[3];
+} CHANNEL_t;
+
+// Load the channel table from NVS into RAM. Only the first call reads NVS.
+// The six keys written by the old teaching app are migrated to channel 0.
+// A blob with a wrong version or CRC is ignored.
+esp_err_t channel_init(void);
+
+// Number of channels in the table
+int channel_count(void);
+
+// Channel of the index, NULL when out of range
+CHANNEL_t *channel_get(int index);
+
+// Find the channel by the name or the index number. Returns -1 when not found.
+int channel_find(const char *name);
+
+// Set the code of the channel. Call channel_save to write the table to NVS.
+esp_err_t channel_set(int index, const char *name, int state, uint32_t code, uint8_t bitlength, uint8_t protocol, uint16_t pulse_length);
+
+// Set the raw code of the channel. Call channel_save to write the table to NVS.
+esp_err_t channel_set_raw(int index, const char *name, int state, const RF_RAW_CODE_t *raw);
+
+// Set the number of times to repeat the frame. 0 means CONFIG_RF_TX_REPEAT.
+esp_err_t channel_set_repeats(int index, int repeats);
+
+// Write the channel table to NVS
+esp_err_t channel_save(void);
+
+// Convert "<channel>/<state>[:<repeats>]" into the command for the transmitter.
+// The channel is the name or the index, the state is "on" or "off".
+// "on" and "off" alone are for the channel 0.
+// repeats overrides the number of times to repeat the frame set to the channel.
+esp_err_t channel_command(const char *path, TX_COMMAND_t *command);
+
+#endif /* CHANNEL_H */
@@ -0,0 +1,180 @@
+/*
+	RF receiver delivering the decoded frames through a queue
+
+	This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+	Unless required by applicable law or agreed to in writing, this
+	software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+	CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#include <stdio.h>
+#include <inttypes.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "esp_log.h"
+
+#if CONFIG_RF_RX_BACKEND_EDGE
+#include "driver/gpio.h"
+#include "esp_attr.h"
+#include "esp_timer.h"
+#else
+#include "RCSwitch.h"
+#endif
+
+#include "receiver.h"
+
+static const char *TAG = "RX";
+
+static QueueHandle_t s_rx_queue = NULL;
+static QueueHandle_t s_raw_queue = NULL;
+
+static void deliver(const RF_FRAME_t *frame) {
+	ESP_LOGI(TAG, "Received %"PRIu32" / %dbit Protocol: %d Pulse: %dus", frame->code, frame->bitlength, frame->protocol, frame->pulse_length);
+	// The oldest frames are kept when nobody is reading
+	xQueueSend(s_rx_queue, frame, 0);
+}
+
+#if CONFIG_RF_RX_BACKEND_EDGE
+// The ISR only records the time between the edges.
+// The frames are decoded by the task.
+#define EDGE_BUFFER_SIZE CONFIG_RF_RX_EDGE_BUFFER
+
+// head and tail wrap at EDGE_BUFFER_SIZE, which need not be a power of two.
+// One slot stays empty, so a full buffer is told apart from an empty one.
+static uint32_t s_edges[EDGE_BUFFER_SIZE];
+static volatile uint32_t s_edge_head = 0; // Written by the ISR
+static volatile uint32_t s_edge_tail = 0; // Written by the task
+static int64_t s_last_edge = 0;
+static TaskHandle_t s_rx_task = NULL;
+
+static void IRAM_ATTR edge_isr(void *arg) {
+	int64_t now = esp_timer_get_time();
+	uint32_t duration = now - s_last_edge;
+	s_last_edge = now;
+
+	uint32_t head = s_edge_head;
+	uint32_t next = head + 1 == EDGE_BUFFER_SIZE ? 0 : head + 1;
+	uint32_t tail = s_edge_tail;
+	if (next == tail) return; // Overflow, the task is too late
+	s_edges[head] = duration;
+	s_edge_head = next;
+
+	// Wake the task at the gap between the frames or when the buffer is getting full
+	uint32_t count = next >= tail ? next - tail : next + EDGE_BUFFER_SIZE - tail;
+	if (duration > RFCODEC_SEPARATION_LIMIT || count >= EDGE_BUFFER_SIZE / 2) {
+		BaseType_t woken = pdFALSE;
+		vTaskNotifyGiveFromISR(s_rx_task, &woken);
+		portYIELD_FROM_ISR(woken);
+	}
+}
+
+static void receiver_task(void *pvParameters) {
+	int gpio = (int)pvParameters;
+	ESP_LOGI(TAG, "Start gpio=%d", gpio);
+
+	RF_DECODER_t decoder;
+	rfcodec_decoder_init(&decoder);
+	RF_SEGMENTER_t segmenter;
+	rfcodec_segmenter_init(&segmenter);
+	RF_RAW_CODE_t raw;
+
+	// The ISR wakes this task
+	s_rx_task = xTaskGetCurrentTaskHandle();
+	gpio_config_t io_conf = {
+		.pin_bit_mask = 1ULL << gpio,
+		.mode = GPIO_MODE_INPUT,
+		.intr_type = GPIO_INTR_ANYEDGE,
+	};
+	ESP_ERROR_CHECK(gpio_config(&io_conf));
+	// The ISR service may have been installed by another component
+	esp_err_t err = gpio_install_isr_service(0);
+	if (err != ESP_OK && err != ESP_ERR_INVALID_STATE) ESP_ERROR_CHECK(err);
+	ESP_ERROR_CHECK(gpio_isr_handler_add(gpio, edge_isr, NULL));
+
+	RF_FRAME_t frame;
+	while(1) {
+		// Also drain the edges which did not wake this task
+		ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(100));
+		while (s_edge_tail != s_edge_head) {
+			uint32_t tail = s_edge_tail;
+			uint32_t duration = s_edges[tail];
+			s_edge_tail = tail + 1 == EDGE_BUFFER_SIZE ? 0 : tail + 1;
+			if (rfcodec_decode(&decoder, duration, &frame)) deliver(&frame);
+			// Also keep the frames of the unknown protocols
+			if (rfcodec_segment(&segmenter, duration, &raw)) xQueueSend(s_raw_queue, &raw, 0);
+		}
+	}
+	vTaskDelete(NULL);
+}
+
+esp_err_t receiver_receive_raw(RF_RAW_CODE_t *raw, TickType_t wait) {
+	if (s_raw_queue == NULL) return ESP_ERR_INVALID_STATE;
+	if (xQueueReceive(s_raw_queue, raw, wait) != pdTRUE) return ESP_ERR_TIMEOUT;
+	return ESP_OK;
+}
+
+#else
+// RCSwitch decodes the frames in the GPIO interrupt
+static void receiver_task(void *pvParameters) {
+	int gpio = (int)pvParameters;
+	ESP_LOGI(TAG, "Start gpio=%d", gpio);
+
+	RCSWITCH_t RCSwitch;
+	initSwich(&RCSwitch);
+	enableReceive(&RCSwitch, gpio);
+
+	RF_FRAME_t frame;
+	while(1) {
+		if (available(&RCSwitch)) {
+			frame.code = getReceivedValue(&RCSwitch);
+			frame.bitlength = getReceivedBitlength(&RCSwitch);
+			frame.protocol = getReceivedProtocol(&RCSwitch);
+			frame.pulse_length = getReceivedDelay(&RCSwitch);
+			resetAvailable(&RCSwitch);
+			deliver(&frame);
+		} else {
+			vTaskDelay(1);
+		}
+	}
+	vTaskDelete(NULL);
+}
+
+esp_err_t receiver_receive_raw(RF_RAW_CODE_t *raw, TickType_t wait) {
+	// RCSwitch does not keep the timings
+	return ESP_ERR_NOT_SUPPORTED;
+}
+#endif
+
+esp_err_t receiver_start(int gpio) {
+	s_rx_queue = xQueueCreate(CONFIG_RF_RX_QUEUE_LENGTH, sizeof(RF_FRAME_t));
+	if (s_rx_queue == NULL) {
+		ESP_LOGE(TAG, "xQueueCreate fail");
+		return ESP_ERR_NO_MEM;
+	}
+#if CONFIG_RF_RX_BACKEND_EDGE
+	s_raw_queue = xQueueCreate(CONFIG_RF_RX_QUEUE_LENGTH, sizeof(RF_RAW_CODE_t));
+	if (s_raw_queue == NULL) {
+		ESP_LOGE(TAG, "xQueueCreate fail");
+		return ESP_ERR_NO_MEM;
+	}
+#endif
+	if (xTaskCreate(receiver_task, "RX", 1024*4, (void *)gpio, 5, NULL) != pdPASS) {
+		ESP_LOGE(TAG, "xTaskCreate fail");
+		return ESP_ERR_NO_MEM;
+	}
+	return ESP_OK;
+}
+
+esp_err_t receiver_receive(RF_FRAME_t *frame, TickType_t wait) {
+	if (s_rx_queue == NULL) return ESP_ERR_INVALID_STATE;
+	if (xQueueReceive(s_rx_queue, frame, wait) != pdTRUE) return ESP_ERR_TIMEOUT;
+	return ESP_OK;
+}
+
+void receiver_flush(void) {
+	if (s_rx_queue != NULL) xQueueReset(s_rx_queue);
+	if (s_raw_queue != NULL) xQueueReset(s_raw_queue);
+}
@@ -0,0 +1,20 @@
+#ifndef RECEIVER_H
+#define RECEIVER_H
+
+#include "freertos/FreeRTOS.h"
+#include "esp_err.h"
+#include "rfcodec.h"
+
+// Start the RF receiver task which owns the GPIO
+esp_err_t receiver_start(int gpio);
+
+// Wait for the next decoded frame. Returns ESP_ERR_TIMEOUT when no frame has been received.
+esp_err_t receiver_receive(RF_FRAME_t *frame, TickType_t wait);
+
+// Wait for the next frame with the raw timings. Only the edge timing backend supports this.
+esp_err_t receiver_receive_raw(RF_RAW_CODE_t *raw, TickType_t wait);
+
+// Discard the frames already received
+void receiver_flush(void);
+
+#endif /* RECEIVER_H */
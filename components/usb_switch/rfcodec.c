@@ -0,0 +1,251 @@
+/*
+	Encoder and decoder of the RF frames
+
+	This file does not depend on ESP-IDF and can be built on a PC.
+
+	This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+	Unless required by applicable law or agreed to in writing, this
+	software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+	CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#include <stddef.h>
+#include <stdlib.h>
+
+#include "rfcodec.h"
+
+static const RF_PROTOCOL_t protocols[] = {
+	{ 350, {  1, 31 }, {  1,  3 }, {  3,  1 }, false }, // protocol 1
+	{ 650, {  1, 10 }, {  1,  2 }, {  2,  1 }, false }, // protocol 2
+	{ 100, { 30, 71 }, {  4, 11 }, {  9,  6 }, false }, // protocol 3
+	{ 380, {  1,  6 }, {  1,  3 }, {  3,  1 }, false }, // protocol 4
+	{ 500, {  6, 14 }, {  1,  2 }, {  2,  1 }, false }, // protocol 5
+	{ 450, { 23,  1 }, {  1,  2 }, {  2,  1 }, true },  // protocol 6 (HT6P20B)
+	{ 150, {  2, 62 }, {  1,  6 }, {  6,  1 }, false }, // protocol 7 (HS2303-PT)
+	{ 200, {  3, 130}, {  7, 16 }, {  3, 16 }, false }, // protocol 8 Conrad RS-200 RX
+	{ 200, { 130, 7 }, { 16,  7 }, { 16,  3 }, true },  // protocol 9 Conrad RS-200 TX
+	{ 365, { 18,  1 }, {  3,  1 }, {  1,  3 }, true },  // protocol 10 (1ByOne Doorbell)
+	{ 270, { 36,  1 }, {  1,  2 }, {  2,  1 }, true },  // protocol 11 (HT12E)
+	{ 320, { 36,  1 }, {  1,  2 }, {  2,  1 }, true },  // protocol 12 (SM5212)
+};
+
+int rfcodec_protocol_count(void) {
+	return sizeof(protocols) / sizeof(protocols[0]);
+}
+
+const RF_PROTOCOL_t *rfcodec_protocol(int protocol) {
+	if (protocol < 1 || protocol > rfcodec_protocol_count()) return NULL;
+	return &protocols[protocol-1];
+}
+
+static void encode_pulse(const RF_PROTOCOL_t *p, int pulse_length, RF_PULSE_t pulse, RF_SYMBOL_t *symbol) {
+	symbol->duration0 = pulse_length * pulse.high;
+	symbol->level0 = p->inverted ? 0 : 1;
+	symbol->duration1 = pulse_length * pulse.low;
+	symbol->level1 = p->inverted ? 1 : 0;
+}
+
+int rfcodec_encode(int protocol, int pulse_length, uint32_t code, int bitlength, RF_SYMBOL_t *symbols, int max) {
+	const RF_PROTOCOL_t *p = rfcodec_protocol(protocol);
+	if (p == NULL) return -1;
+	if (bitlength < 1 || bitlength > 32 || bitlength + 1 > max) return -1;
+	if (pulse_length == 0) pulse_length = p->pulse_length;
+	// The RMT symbol has 15 bits for the duration
+	const RF_PULSE_t *pulses[] = { &p->sync, &p->zero, &p->one };
+	for (int i=0;i<3;i++) {
+		if (pulse_length * pulses[i]->high > 0x7fff || pulse_length * pulses[i]->low > 0x7fff) return -1;
+	}
+
+	int count = 0;
+	for (int i=bitlength-1;i>=0;i--) {
+		encode_pulse(p, pulse_length, (code >> i) & 1 ? p->one : p->zero, &symbols[count++]);
+	}
+	encode_pulse(p, pulse_length, p->sync, &symbols[count++]);
+	return count;
+}
+
+void rfcodec_decoder_init(RF_DECODER_t *decoder) {
+	decoder->change_count = 0;
+	decoder->repeat_count = 0;
+}
+
+// Same as receiveProtocol of rc-switch
+static bool receive_protocol(RF_DECODER_t *decoder, int protocol, RF_FRAME_t *frame) {
+	const RF_PROTOCOL_t *p = rfcodec_protocol(protocol);
+	int change_count = decoder->change_count;
+	uint32_t *timings = decoder->timings;
+
+	// timings[0] is the sync gap in front of the data
+	uint32_t sync_length = p->inverted ? p->sync.high : p->sync.low;
+	uint32_t delay = timings[0] / sync_length;
+	uint32_t tolerance = delay * RFCODEC_TOLERANCE / 100;
+	uint32_t code = 0;
+	int first = p->inverted ? 2 : 1;
+	for (int i=first;i<change_count-1;i+=2) {
+		code <<= 1;
+		if (labs((long)timings[i] - (long)(delay * p->zero.high)) < tolerance &&
+			labs((long)timings[i+1] - (long)(delay * p->zero.low)) < tolerance) {
+			// zero
+		} else if (labs((long)timings[i] - (long)(delay * p->one.high)) < tolerance &&
+			labs((long)timings[i+1] - (long)(delay * p->one.low)) < tolerance) {
+			code |= 1;
+		} else {
+			return false;
+		}
+	}
+
+	// Ignore very short transmissions: no device sends them, so this must be noise
+	if (change_count <= 7) return false;
+	frame->code = code;
+	frame->bitlength = (change_count - 1) / 2;
+	frame->protocol = protocol;
+	frame->pulse_length = delay;
+	return true;
+}
+
+bool rfcodec_decode(RF_DECODER_t *decoder, uint32_t duration, RF_FRAME_t *frame) {
+	bool found = false;
+	if (duration > RFCODEC_SEPARATION_LIMIT) {
+		// A long stretch without signal level change occurred.
+		// This could be the gap between two transmissions.
+		if (decoder->change_count > 0 && labs((long)duration - (long)decoder->timings[0]) < 200) {
+			// This long signal is close in length to the long signal which started the previously recorded timings.
+			// This suggests that it may indeed be a gap between two transmissions.
+			decoder->repeat_count++;
+			if (decoder->repeat_count == 2) {
+				for (int protocol=1;protocol<=rfcodec_protocol_count();protocol++) {
+					if (receive_protocol(decoder, protocol, frame)) {
+						found = true;
+						break;
+					}
+				}
+				decoder->repeat_count = 0;
+			}
+		}
+		decoder->change_count = 0;
+	}
+
+	// Detect overflow
+	if (decoder->change_count >= RFCODEC_CHANGES_MAX) {
+		decoder->change_count = 0;
+		decoder->repeat_count = 0;
+	}
+	decoder->timings[decoder->change_count++] = duration;
+	return found;
+}
+
+int rfcodec_raw_compress(const uint32_t *durations, int count, RF_RAW_CODE_t *raw) {
+	if (count < 2 || count > RFCODEC_RAW_MAX) return -1;
+
+	// Sort the durations
+	uint32_t sorted[RFCODEC_RAW_MAX];
+	for (int i=0;i<count;i++) {
+		uint32_t value = durations[i] > 0x7fff ? 0x7fff : durations[i];
+		int j;
+		for (j=i;j>0 && sorted[j-1]>value;j--) sorted[j] = sorted[j-1];
+		sorted[j] = value;
+	}
+
+	// The levels are separated where the sorted durations jump more than the tolerance.
+	// A level is the average of its durations.
+	int nlevel = 0;
+	uint32_t sum = 0;
+	int members = 0;
+	for (int i=0;i<=count;i++) {
+		if (i == count || (members && sorted[i] > sorted[i-1] * (100 + RFCODEC_RAW_TOLERANCE) / 100)) {
+			if (nlevel == RFCODEC_RAW_LEVELS) return -1;
+			raw->levels[nlevel++] = sum / members;
+			members = 0;
+			sum = 0;
+		}
+		if (i == count) break;
+		sum += sorted[i];
+		members++;
+	}
+	raw->nlevel = nlevel;
+	raw->count = count;
+
+	// Replace each duration with the nearest level
+	for (int i=0;i<count;i++) {
+		int best = 0;
+		for (int level=1;level<nlevel;level++) {
+			if (labs((long)durations[i] - (long)raw->levels[level]) < labs((long)durations[i] - (long)raw->levels[best])) best = level;
+		}
+		if (i % 2 == 0) {
+			raw->index[i/2] = best;
+		} else {
+			raw->index[i/2] |= best << 4;
+		}
+	}
+	return 0;
+}
+
+static int raw_index(const RF_RAW_CODE_t *raw, int i) {
+	return (raw->index[i/2] >> ((i % 2) * 4)) & 0x0f;
+}
+
+int rfcodec_raw_expand(const RF_RAW_CODE_t *raw, uint16_t *durations, int max) {
+	int count = raw->count < max ? raw->count : max;
+	for (int i=0;i<count;i++) {
+		durations[i] = raw->levels[raw_index(raw, i)];
+	}
+	return count;
+}
+
+bool rfcodec_raw_equal(const RF_RAW_CODE_t *a, const RF_RAW_CODE_t *b) {
+	if (a->count != b->count || a->nlevel != b->nlevel) return false;
+	for (int level=0;level<a->nlevel;level++) {
+		if (labs((long)a->levels[level] - (long)b->levels[level]) > a->levels[level] * RFCODEC_RAW_TOLERANCE / 100) return false;
+	}
+	for (int i=0;i<a->count;i++) {
+		if (raw_index(a, i) != raw_index(b, i)) return false;
+	}
+	return true;
+}
+
+int rfcodec_encode_raw(const RF_RAW_CODE_t *raw, RF_SYMBOL_t *symbols, int max) {
+	// The gap, then the pairs of high and low. The gap is sent at the end like the sync.
+	if (raw->count < 2 || raw->count % 2 != 0 || raw->count > RFCODEC_RAW_MAX) return -1;
+	if (raw->nlevel == 0 || raw->nlevel > RFCODEC_RAW_LEVELS) return -1;
+	if (raw->count / 2 > max) return -1;
+	uint16_t durations[RFCODEC_RAW_MAX];
+	int count = rfcodec_raw_expand(raw, durations, RFCODEC_RAW_MAX);
+	int nsymbol = 0;
+	for (int i=1;i<count;i+=2) {
+		symbols[nsymbol].duration0 = durations[i];
+		symbols[nsymbol].level0 = 1;
+		symbols[nsymbol].duration1 = i+1 < count ? durations[i+1] : durations[0];
+		symbols[nsymbol].level1 = 0;
+		nsymbol++;
+	}
+	return nsymbol;
+}
+
+void rfcodec_segmenter_init(RF_SEGMENTER_t *segmenter) {
+	segmenter->count = 0;
+	segmenter->overflow = false;
+}
+
+bool rfcodec_segment(RF_SEGMENTER_t *segmenter, uint32_t duration, RF_RAW_CODE_t *raw) {
+	bool found = false;
+	if (duration > RFCODEC_SEPARATION_LIMIT) {
+		// A frame starts with the gap (low) and ends with high, before the next gap of the same length
+		uint32_t gap = segmenter->timings[0];
+		if (!segmenter->overflow && segmenter->count >= 9 && segmenter->count % 2 == 0 &&
+			gap > RFCODEC_SEPARATION_LIMIT &&
+			labs((long)duration - (long)gap) <= gap * RFCODEC_RAW_TOLERANCE / 100) {
+			found = (rfcodec_raw_compress(segmenter->timings, segmenter->count, raw) == 0);
+		}
+		segmenter->count = 0;
+		segmenter->overflow = false;
+	}
+
+	// Skip the frame longer than the buffer
+	if (segmenter->count >= RFCODEC_RAW_MAX) {
+		segmenter->overflow = true;
+		return found;
+	}
+	segmenter->timings[segmenter->count++] = duration;
+	return found;
+}
@@ -0,0 +1,121 @@
+#ifndef RFCODEC_H
+#define RFCODEC_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// 32 data bits and the sync
+#define RFCODEC_SYMBOL_MAX 33
+
+// Same as rc-switch
+#define RFCODEC_SEPARATION_LIMIT 4300 // microseconds
+#define RFCODEC_TOLERANCE 60 // percent
+#define RFCODEC_CHANGES_MAX 67
+
+// Raw code
+#define RFCODEC_PROTOCOL_RAW 0xff
+#define RFCODEC_RAW_MAX 128 // Durations in one frame
+#define RFCODEC_RAW_LEVELS 8 // Distinct durations in one frame
+#define RFCODEC_RAW_TOLERANCE 25 // percent
+#define RFCODEC_RAW_SYMBOL_MAX (RFCODEC_RAW_MAX / 2)
+
+typedef struct {
+	uint8_t high;
+	uint8_t low;
+} RF_PULSE_t;
+
+// Same as the protocol table of rc-switch
+typedef struct {
+	uint16_t pulse_length; // microseconds
+	RF_PULSE_t sync;
+	RF_PULSE_t zero;
+	RF_PULSE_t one;
+	bool inverted;
+} RF_PROTOCOL_t;
+
+// Same layout as rmt_symbol_word_t with 1 tick = 1 microsecond,
+// so the symbols can be handed to the RMT without conversion
+typedef struct {
+	uint32_t duration0 : 15;
+	uint32_t level0 : 1;
+	uint32_t duration1 : 15;
+	uint32_t level1 : 1;
+} RF_SYMBOL_t;
+
+// Frame encoded in advance
+typedef struct {
+	RF_SYMBOL_t *symbols;
+	uint16_t nsymbol;
+} RF_WAVEFORM_t;
+
+// Frame found by the decoder
+typedef struct {
+	uint32_t code;
+	uint8_t bitlength;
+	uint8_t protocol;
+	uint16_t pulse_length; // Measured pulse length in microseconds
+} RF_FRAME_t;
+
+// State of the decoder, same as handleInterrupt of rc-switch
+typedef struct {
+	uint32_t timings[RFCODEC_CHANGES_MAX];
+	int change_count;
+	int repeat_count;
+} RF_DECODER_t;
+
+// Frame of an unknown protocol.
+// The durations are quantized to the levels, and each duration is stored as a 4 bit index to the levels.
+// The first duration is the gap (low) in front of the frame, then high and low alternate.
+typedef struct {
+	uint8_t count; // Number of the durations
+	uint8_t nlevel;
+	uint16_t levels[RFCODEC_RAW_LEVELS]; // microseconds
+	uint8_t index[RFCODEC_RAW_MAX / 2];
+} RF_RAW_CODE_t;
+
+// State of the raw frame collector
+typedef struct {
+	uint32_t timings[RFCODEC_RAW_MAX];
+	int count;
+	bool overflow;
+} RF_SEGMENTER_t;
+
+// Number of the protocols. The protocol number starts with 1.
+int rfcodec_protocol_count(void);
+
+// Protocol of the number, NULL when not supported
+const RF_PROTOCOL_t *rfcodec_protocol(int protocol);
+
+// Encode one frame (the data bits MSB first, then the sync) like sendCode of rc-switch.
+// pulse_length 0 means the default of the protocol.
+// Returns the number of the symbols, or -1 when the protocol or the bitlength is wrong.
+int rfcodec_encode(int protocol, int pulse_length, uint32_t code, int bitlength, RF_SYMBOL_t *symbols, int max);
+
+// Reset the decoder
+void rfcodec_decoder_init(RF_DECODER_t *decoder);
+
+// Feed the duration between two edges in microseconds.
+// Returns true when a frame has been decoded.
+bool rfcodec_decode(RF_DECODER_t *decoder, uint32_t duration, RF_FRAME_t *frame);
+
+// Quantize the durations of a frame. Returns -1 when the frame has too many durations or levels.
+int rfcodec_raw_compress(const uint32_t *durations, int count, RF_RAW_CODE_t *raw);
+
+// Restore the durations from the raw code. Returns the number of the durations.
+int rfcodec_raw_expand(const RF_RAW_CODE_t *raw, uint16_t *durations, int max);
+
+// Compare the raw codes allowing RFCODEC_RAW_TOLERANCE
+bool rfcodec_raw_equal(const RF_RAW_CODE_t *a, const RF_RAW_CODE_t *b);
+
+// Encode the raw code in the same format as rfcodec_encode.
+// Returns the number of the symbols, or -1 when the raw code is wrong.
+int rfcodec_encode_raw(const RF_RAW_CODE_t *raw, RF_SYMBOL_t *symbols, int max);
+
+// Reset the raw frame collector
+void rfcodec_segmenter_init(RF_SEGMENTER_t *segmenter);
+
+// Feed the duration between two edges in microseconds.
+// Returns true when a frame between two similar gaps has been quantized.
+bool rfcodec_segment(RF_SEGMENTER_t *segmenter, uint32_t duration, RF_RAW_CODE_t *raw);
+
+#endif /* RFCODEC_H */
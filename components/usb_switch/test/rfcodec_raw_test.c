@@ -0,0 +1,245 @@
+/*
+	Test of the raw codes on the host
+
+	This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+	Unless required by applicable law or agreed to in writing, this
+	software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+	CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "rfcodec.h"
+
+// Edge durations in microseconds, as the receiver records them with up to 8% of jitter.
+// The first duration is the gap (low) in front of the frame, then high and low alternate.
+
+// EV1527 code 0x5A3C91 with 320/960 us pulses, received twice
+static const uint32_t trace1[] = {
+	9954, 335, 1030, 927, 333, 330, 984, 900, 295, 942, 332, 307, 960, 931, 337, 342, 944,
+	345, 892, 336, 1017, 906, 330, 969, 343, 915, 322, 1018, 327, 310, 895, 342, 956, 1036,
+	301, 335, 1008, 341, 885, 940, 297, 332, 937, 343, 940, 334, 1016, 919, 322, 343
+};
+
+static const uint32_t trace1_repeat[] = {
+	9962, 312, 924, 1004, 304, 325, 968, 968, 301, 984, 341, 310, 934, 1022, 324, 308, 884,
+	332, 936, 318, 925, 980, 331, 930, 298, 1034, 340, 886, 323, 329, 945, 331, 1030, 973,
+	314, 304, 921, 302, 900, 915, 337, 321, 1006, 341, 1007, 296, 1025, 897, 333, 337
+};
+
+// Remote of an unknown protocol with five durations
+static const uint32_t trace2[] = {
+	7688, 2461, 932, 233, 510, 479, 251, 240, 473, 241, 258, 498, 491, 997, 252, 250, 991,
+	537, 260, 239, 485, 475, 244, 231, 519, 252, 246, 531, 486, 1012, 267, 252, 1018, 489,
+	269, 2601, 968, 244, 507, 501, 250, 237, 506, 258, 260, 247
+};
+
+typedef struct {
+	const char *name;
+	const uint32_t *durations;
+	int count;
+	const uint16_t *nominal; // Nominal durations in ascending order
+	int nnominal;
+} RAW_TRACE_t;
+
+static const uint16_t nominal1[] = { 320, 960, 9920 };
+static const uint16_t nominal2[] = { 250, 500, 1000, 2500, 7500 };
+
+static const RAW_TRACE_t traces[] = {
+	{ "trace1", trace1, sizeof(trace1)/sizeof(trace1[0]), nominal1, sizeof(nominal1)/sizeof(nominal1[0]) },
+	{ "trace1_repeat", trace1_repeat, sizeof(trace1_repeat)/sizeof(trace1_repeat[0]), nominal1, sizeof(nominal1)/sizeof(nominal1[0]) },
+	{ "trace2", trace2, sizeof(trace2)/sizeof(trace2[0]), nominal2, sizeof(nominal2)/sizeof(nominal2[0]) },
+};
+
+static int packed_index(const RF_RAW_CODE_t *raw, int i) {
+	return (raw->index[i/2] >> ((i % 2) * 4)) & 0x0f;
+}
+
+static int nearest(const uint16_t *values, int count, uint32_t duration) {
+	int best = 0;
+	for (int i=1;i<count;i++) {
+		if (labs((long)duration - (long)values[i]) < labs((long)duration - (long)values[best])) best = i;
+	}
+	return best;
+}
+
+static bool within(uint32_t value, uint32_t expected) {
+	return labs((long)value - (long)expected) <= expected * RFCODEC_RAW_TOLERANCE / 100;
+}
+
+// Quantization, index packing and the round trip of one trace
+static int check_trace(const RAW_TRACE_t *t) {
+	RF_RAW_CODE_t raw;
+	if (rfcodec_raw_compress(t->durations, t->count, &raw) != 0) {
+		printf("FAIL %s: not compressed\n", t->name);
+		return 1;
+	}
+	if (raw.count != t->count || raw.nlevel != t->nnominal) {
+		printf("FAIL %s: %d durations %d levels, expected %d %d\n", t->name, raw.count, raw.nlevel, t->count, t->nnominal);
+		return 1;
+	}
+	for (int level=0;level<raw.nlevel;level++) {
+		if (!within(raw.levels[level], t->nominal[level])) {
+			printf("FAIL %s: level %d is %d, expected %d\n", t->name, level, raw.levels[level], t->nominal[level]);
+			return 1;
+		}
+	}
+	for (int i=0;i<t->count;i++) {
+		int expected = nearest(t->nominal, t->nnominal, t->durations[i]);
+		if (packed_index(&raw, i) != expected) {
+			printf("FAIL %s: index %d is %d, expected %d\n", t->name, i, packed_index(&raw, i), expected);
+			return 1;
+		}
+	}
+
+	uint16_t durations[RFCODEC_RAW_MAX];
+	if (rfcodec_raw_expand(&raw, durations, RFCODEC_RAW_MAX) != t->count) {
+		printf("FAIL %s: expand\n", t->name);
+		return 1;
+	}
+	for (int i=0;i<t->count;i++) {
+		if (!within(durations[i], t->durations[i])) {
+			printf("FAIL %s: duration %d is %d, recorded %d\n", t->name, i, durations[i], (int)t->durations[i]);
+			return 1;
+		}
+	}
+
+	// The pairs of high and low, and the gap at the end
+	RF_SYMBOL_t symbols[RFCODEC_RAW_SYMBOL_MAX];
+	int nsymbol = rfcodec_encode_raw(&raw, symbols, RFCODEC_RAW_SYMBOL_MAX);
+	if (nsymbol != t->count / 2) {
+		printf("FAIL %s: %d symbols\n", t->name, nsymbol);
+		return 1;
+	}
+	for (int i=0;i<nsymbol;i++) {
+		uint32_t high = t->durations[i*2+1];
+		uint32_t low = (i*2+2 < t->count) ? t->durations[i*2+2] : t->durations[0];
+		if (symbols[i].level0 != 1 || symbols[i].level1 != 0 || !within(symbols[i].duration0, high) || !within(symbols[i].duration1, low)) {
+			printf("FAIL %s: symbol %d is %d:%d %d:%d, recorded %d %d\n", t->name, i,
+				symbols[i].level0, symbols[i].duration0, symbols[i].level1, symbols[i].duration1, (int)high, (int)low);
+			return 1;
+		}
+	}
+	return 0;
+}
+
+// The index of the even duration is in the low nibble
+static int check_packing(void) {
+	static const uint32_t durations[] = { 5000, 300, 900, 900, 300, 300, 900, 5000 };
+	static const uint8_t expected[] = { 0x02, 0x11, 0x00, 0x21 };
+	RF_RAW_CODE_t raw;
+	if (rfcodec_raw_compress(durations, 8, &raw) != 0 || raw.nlevel != 3) {
+		printf("FAIL packing: not compressed\n");
+		return 1;
+	}
+	for (int i=0;i<sizeof(expected);i++) {
+		if (raw.index[i] != expected[i]) {
+			printf("FAIL packing: byte %d is 0x%02x, expected 0x%02x\n", i, raw.index[i], expected[i]);
+			return 1;
+		}
+	}
+	return 0;
+}
+
+static int check_errors(void) {
+	int failed = 0;
+	RF_RAW_CODE_t raw;
+	// Nine durations too far apart to share a level
+	static const uint32_t levels9[] = { 5000, 100, 200, 400, 800, 1600, 3200, 6400, 12800, 100 };
+	if (rfcodec_raw_compress(levels9, 10, &raw) != -1) {
+		printf("FAIL nine levels were accepted\n");
+		failed++;
+	}
+	if (rfcodec_raw_compress(trace1, 1, &raw) != -1) {
+		printf("FAIL one duration was accepted\n");
+		failed++;
+	}
+	uint32_t long_frame[RFCODEC_RAW_MAX + 2] = { 0 };
+	if (rfcodec_raw_compress(long_frame, RFCODEC_RAW_MAX + 1, &raw) != -1) {
+		printf("FAIL %d durations were accepted\n", RFCODEC_RAW_MAX + 1);
+		failed++;
+	}
+	// An odd number of durations has no gap at the end
+	if (rfcodec_raw_compress(trace1, 49, &raw) != 0 || rfcodec_encode_raw(&raw, NULL, 0) != -1) {
+		printf("FAIL odd number of durations\n");
+		failed++;
+	}
+
+	// The same frame received twice is equal, another frame is not
+	RF_RAW_CODE_t a, b;
+	rfcodec_raw_compress(trace1, sizeof(trace1)/sizeof(trace1[0]), &a);
+	rfcodec_raw_compress(trace1_repeat, sizeof(trace1_repeat)/sizeof(trace1_repeat[0]), &b);
+	if (!rfcodec_raw_equal(&a, &b)) {
+		printf("FAIL trace1 and trace1_repeat differ\n");
+		failed++;
+	}
+	rfcodec_raw_compress(trace2, sizeof(trace2)/sizeof(trace2[0]), &b);
+	if (rfcodec_raw_equal(&a, &b)) {
+		printf("FAIL trace1 and trace2 are equal\n");
+		failed++;
+	}
+	// Levels 40% longer
+	b = a;
+	for (int level=0;level<b.nlevel;level++) b.levels[level] = b.levels[level] * 140 / 100;
+	if (rfcodec_raw_equal(&a, &b)) {
+		printf("FAIL levels out of the tolerance are equal\n");
+		failed++;
+	}
+	return failed;
+}
+
+static int feed(RF_SEGMENTER_t *segmenter, const uint32_t *durations, int count, RF_RAW_CODE_t *frames, int nframe) {
+	RF_RAW_CODE_t raw;
+	for (int i=0;i<count;i++) {
+		if (rfcodec_segment(segmenter, durations[i], &raw)) frames[nframe++] = raw;
+	}
+	return nframe;
+}
+
+// The frames are cut at the gaps, as they come from the receiver
+static int check_segmenter(void) {
+	RF_SEGMENTER_t segmenter;
+	rfcodec_segmenter_init(&segmenter);
+	RF_RAW_CODE_t frames[4];
+	int nframe = 0;
+
+	// A frame longer than the buffer is skipped
+	uint32_t noise[RFCODEC_RAW_MAX + 10];
+	noise[0] = trace1[0];
+	for (int i=1;i<sizeof(noise)/sizeof(noise[0]);i++) noise[i] = (i % 2) ? 320 : 960;
+	nframe = feed(&segmenter, noise, sizeof(noise)/sizeof(noise[0]), frames, nframe);
+
+	nframe = feed(&segmenter, trace1, sizeof(trace1)/sizeof(trace1[0]), frames, nframe);
+	nframe = feed(&segmenter, trace1_repeat, sizeof(trace1_repeat)/sizeof(trace1_repeat[0]), frames, nframe);
+	// The gap in front of the next frame ends the last one
+	nframe = feed(&segmenter, trace1, 1, frames, nframe);
+	if (nframe != 2) {
+		printf("FAIL segmenter: %d frames, expected 2\n", nframe);
+		return 1;
+	}
+
+	RF_RAW_CODE_t expected;
+	rfcodec_raw_compress(trace1, sizeof(trace1)/sizeof(trace1[0]), &expected);
+	for (int i=0;i<nframe;i++) {
+		if (!rfcodec_raw_equal(&frames[i], &expected)) {
+			printf("FAIL segmenter: frame %d differs\n", i);
+			return 1;
+		}
+	}
+	return 0;
+}
+
+int main(void) {
+	int failed = 0;
+	for (int i=0;i<sizeof(traces)/sizeof(traces[0]);i++) {
+		failed += check_trace(&traces[i]);
+	}
+	failed += check_packing();
+	failed += check_errors();
+	failed += check_segmenter();
+	printf("%d failed\n", failed);
+	return failed ? 1 : 0;
+}
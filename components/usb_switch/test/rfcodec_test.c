@@ -0,0 +1,142 @@
+/*
+	Test of the RF frame encoder on the host
+
+	This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+	Unless required by applicable law or agreed to in writing, this
+	software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+	CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "rfcodec.h"
+
+// Edges as send() of rc-switch emits them with setRepeatTransmit(repeats).
+// Positive is HIGH and negative is LOW, in microseconds.
+// protocol 1, the example of rc-switch
+static const int32_t edges1[] = {
+	350, -1050, 350, -1050, 350, -1050, 350, -1050, 350, -1050, 350, -1050, 350, -1050,
+	350, -1050, 350, -1050, 350, -1050, 350, -1050, 1050, -350, 350, -1050, 1050, -350,
+	350, -1050, 1050, -350, 350, -1050, 350, -1050, 350, -1050, 1050, -350, 350, -1050,
+	350, -1050, 350, -1050, 1050, -350, 350, -10850
+};
+
+// protocol 2, two repeats
+static const int32_t edges2[] = {
+	650, -1300, 1300, -650, 650, -1300, 1300, -650, 650, -6500, 650, -1300, 1300, -650,
+	650, -1300, 1300, -650, 650, -6500
+};
+
+// protocol 3 with setPulseLength(120)
+static const int32_t edges3[] = {
+	1080, -720, 480, -1320, 1080, -720, 480, -1320, 480, -1320, 1080, -720, 480, -1320,
+	1080, -720, 3600, -8520
+};
+
+// protocol 6, inverted
+static const int32_t edges4[] = {
+	-450, 900, -900, 450, -450, 900, -10350, 450, -450, 900, -900, 450, -450, 900, -10350,
+	450
+};
+
+// protocol 7, one bit and three repeats
+static const int32_t edges5[] = {
+	900, -150, 300, -9300, 900, -150, 300, -9300, 900, -150, 300, -9300
+};
+
+// protocol 11, inverted
+static const int32_t edges6[] = {
+	-270, 540, -270, 540, -270, 540, -270, 540, -540, 270, -540, 270, -540, 270, -540, 270,
+	-270, 540, -270, 540, -270, 540, -270, 540, -9720, 270
+};
+
+typedef struct {
+	int protocol;
+	int pulse_length; // 0 is the default of the protocol
+	uint32_t code;
+	int bitlength;
+	int repeats;
+	const int32_t *edges;
+	int nedge;
+} ENCODE_CASE_t;
+
+static const ENCODE_CASE_t cases[] = {
+	{ 1, 0, 0x1511, 24, 1, edges1, sizeof(edges1)/sizeof(edges1[0]) },
+	{ 2, 0, 0x5, 4, 2, edges2, sizeof(edges2)/sizeof(edges2[0]) },
+	{ 3, 120, 0xA5, 8, 1, edges3, sizeof(edges3)/sizeof(edges3[0]) },
+	{ 6, 0, 0x2, 3, 2, edges4, sizeof(edges4)/sizeof(edges4[0]) },
+	{ 7, 0, 0x1, 1, 3, edges5, sizeof(edges5)/sizeof(edges5[0]) },
+	{ 11, 0, 0xF0, 12, 1, edges6, sizeof(edges6)/sizeof(edges6[0]) },
+};
+
+// The frame is encoded once and sent repeatedly, as the transmitter does
+static int check_case(const ENCODE_CASE_t *c) {
+	RF_SYMBOL_t symbols[RFCODEC_SYMBOL_MAX];
+	int nsymbol = rfcodec_encode(c->protocol, c->pulse_length, c->code, c->bitlength, symbols, RFCODEC_SYMBOL_MAX);
+	if (nsymbol != c->bitlength + 1) {
+		printf("FAIL protocol %d code 0x%X: %d symbols\n", c->protocol, (unsigned)c->code, nsymbol);
+		return 1;
+	}
+	int nedge = 0;
+	for (int r=0;r<c->repeats;r++) {
+		for (int i=0;i<nsymbol;i++) {
+			int32_t edge[2];
+			edge[0] = symbols[i].level0 ? (int32_t)symbols[i].duration0 : -(int32_t)symbols[i].duration0;
+			edge[1] = symbols[i].level1 ? (int32_t)symbols[i].duration1 : -(int32_t)symbols[i].duration1;
+			for (int j=0;j<2;j++) {
+				if (nedge >= c->nedge || edge[j] != c->edges[nedge]) {
+					printf("FAIL protocol %d code 0x%X: edge %d is %d, expected %d\n", c->protocol, (unsigned)c->code,
+						nedge, (int)edge[j], nedge < c->nedge ? (int)c->edges[nedge] : 0);
+					return 1;
+				}
+				nedge++;
+			}
+		}
+	}
+	if (nedge != c->nedge) {
+		printf("FAIL protocol %d code 0x%X: %d edges, expected %d\n", c->protocol, (unsigned)c->code, nedge, c->nedge);
+		return 1;
+	}
+	return 0;
+}
+
+// Arguments that rfcodec_encode must reject
+static int check_errors(void) {
+	RF_SYMBOL_t symbols[RFCODEC_SYMBOL_MAX];
+	int failed = 0;
+	struct {
+		const char *name;
+		int result;
+	} errors[] = {
+		{ "protocol 0", rfcodec_encode(0, 0, 1, 24, symbols, RFCODEC_SYMBOL_MAX) },
+		{ "unknown protocol", rfcodec_encode(rfcodec_protocol_count() + 1, 0, 1, 24, symbols, RFCODEC_SYMBOL_MAX) },
+		{ "bitlength 0", rfcodec_encode(1, 0, 1, 0, symbols, RFCODEC_SYMBOL_MAX) },
+		{ "bitlength 33", rfcodec_encode(1, 0, 1, 33, symbols, RFCODEC_SYMBOL_MAX) },
+		{ "no room for the sync", rfcodec_encode(1, 0, 1, 24, symbols, 24) },
+		{ "duration over 15 bits", rfcodec_encode(8, 300, 1, 24, symbols, RFCODEC_SYMBOL_MAX) },
+	};
+	for (int i=0;i<sizeof(errors)/sizeof(errors[0]);i++) {
+		if (errors[i].result != -1) {
+			printf("FAIL %s: %d, expected -1\n", errors[i].name, errors[i].result);
+			failed++;
+		}
+	}
+	// 32 bits and the sync just fit
+	if (rfcodec_encode(1, 0, 0xffffffff, 32, symbols, RFCODEC_SYMBOL_MAX) != 33) {
+		printf("FAIL bitlength 32\n");
+		failed++;
+	}
+	return failed;
+}
+
+int main(void) {
+	int failed = 0;
+	for (int i=0;i<sizeof(cases)/sizeof(cases[0]);i++) {
+		failed += check_case(&cases[i]);
+	}
+	failed += check_errors();
+	printf("%d failed\n", failed);
+	return failed ? 1 : 0;
+}
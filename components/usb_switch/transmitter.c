@@ -0,0 +1,318 @@
+/*
+	RF transmitter shared by all the requests
+
+	This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+	Unless required by applicable law or agreed to in writing, this
+	software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+	CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#include <stdio.h>
+#include <inttypes.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#if CONFIG_RF_TX_BACKEND_RMT
+#include "driver/rmt_tx.h"
+#include "soc/soc_caps.h"
+#include "rfcodec.h"
+#else
+#include "RCSwitch.h"
+#endif
+
+#include "transmitter.h"
+#if CONFIG_RF_TX_VERIFY
+#include "receiver.h"
+#endif
+
+static const char *TAG = "TX";
+
+// Command with the time it was queued
+typedef struct {
+	TX_COMMAND_t command;
+	TickType_t queued; // Start of the coalescing window
+	int64_t queued_us; // For the wait time reported in TX_RESULT_t
+} TX_REQUEST_t;
+
+static QueueHandle_t s_tx_queue = NULL;
+
+// Requests waiting for the coalescing window, in the order they were queued
+static TX_REQUEST_t s_pending[CONFIG_RF_TX_QUEUE_LENGTH];
+static int s_npending = 0;
+
+// Wait time to queue the result. A full reply queue must not stall the transmitter.
+#define TX_REPLY_WAIT_MS 100
+
+#if CONFIG_RF_TX_BACKEND_RMT
+// The raw frames are longer than the coded frames
+#define TX_SYMBOL_MAX RFCODEC_RAW_SYMBOL_MAX
+
+_Static_assert(sizeof(RF_SYMBOL_t) == sizeof(rmt_symbol_word_t), "RF_SYMBOL_t must have the layout of rmt_symbol_word_t");
+
+// The RMT clocks out the frames, so this task sleeps while sending
+typedef struct {
+	rmt_channel_handle_t channel;
+	rmt_encoder_handle_t encoder;
+} RF_BACKEND_t;
+
+static esp_err_t backend_init(RF_BACKEND_t *backend, int gpio) {
+	rmt_tx_channel_config_t channel_config = {
+		.gpio_num = gpio,
+		.clk_src = RMT_CLK_SRC_DEFAULT,
+		.resolution_hz = 1000000, // 1 tick = 1 microsecond
+#if SOC_RMT_SUPPORT_DMA
+		.mem_block_symbols = 64,
+		.flags.with_dma = true,
+#else
+		.mem_block_symbols = SOC_RMT_MEM_WORDS_PER_CHANNEL,
+#endif
+#if CONFIG_RF_TX_VERIFY
+		.trans_queue_depth = 2, // Few frames are queued ahead of the verification
+#else
+		.trans_queue_depth = 4,
+#endif
+	};
+	esp_err_t err = rmt_new_tx_channel(&channel_config, &backend->channel);
+	if (err != ESP_OK) return err;
+	rmt_copy_encoder_config_t encoder_config = {};
+	err = rmt_new_copy_encoder(&encoder_config, &backend->encoder);
+	if (err != ESP_OK) return err;
+	return rmt_enable(backend->channel);
+}
+
+#if CONFIG_RF_TX_VERIFY
+// Check whether the receiver has decoded the frame being sent
+static bool frame_heard(const TX_COMMAND_t *command) {
+	if (command->raw != NULL) {
+		RF_RAW_CODE_t raw;
+		while (receiver_receive_raw(&raw, 0) == ESP_OK) {
+			if (rfcodec_raw_equal(&raw, command->raw)) return true;
+		}
+	} else {
+		RF_FRAME_t frame;
+		while (receiver_receive(&frame, 0) == ESP_OK) {
+			if (frame.code == command->code && frame.bitlength == command->bitlength) return true;
+		}
+	}
+	return false;
+}
+#endif
+
+static esp_err_t backend_send(RF_BACKEND_t *backend, const TX_COMMAND_t *command, int repeats) {
+	// Use the frame encoded in advance, otherwise encode the frame once and send it repeatedly
+	RF_SYMBOL_t frame[TX_SYMBOL_MAX];
+	const RF_SYMBOL_t *symbols = frame;
+	int nsymbol;
+	if (command->waveform != NULL) {
+		symbols = command->waveform->symbols;
+		nsymbol = command->waveform->nsymbol;
+	} else if (command->raw != NULL) {
+		nsymbol = rfcodec_encode_raw(command->raw, frame, TX_SYMBOL_MAX);
+	} else {
+		nsymbol = rfcodec_encode(command->protocol, command->pulse_length, command->code, command->bitlength, frame, TX_SYMBOL_MAX);
+	}
+	if (nsymbol <= 0) return ESP_ERR_INVALID_ARG;
+
+	rmt_transmit_config_t transmit_config = {
+		.loop_count = 0,
+		.flags.eot_level = 0,
+	};
+	esp_err_t err = ESP_OK;
+#if CONFIG_RF_TX_VERIFY
+	receiver_flush();
+#endif
+	for (int i=0;i<repeats && err == ESP_OK;i++) {
+		// Blocks while the RMT queue is full, so the frames follow each other without a gap
+		err = rmt_transmit(backend->channel, backend->encoder, symbols, nsymbol * sizeof(RF_SYMBOL_t), &transmit_config);
+#if CONFIG_RF_TX_VERIFY
+		// Stop repeating once our own frame has been received
+		if (err == ESP_OK && frame_heard(command)) {
+			ESP_LOGI(TAG, "Heard after %d of %d frames", i+1, repeats);
+			break;
+		}
+#endif
+	}
+	// The symbols must live until the RMT has finished
+	esp_err_t done = rmt_tx_wait_all_done(backend->channel, -1);
+	return err != ESP_OK ? err : done;
+}
+
+#else
+// RCSwitch bit-bangs the GPIO with busy-wait delays
+typedef struct {
+	RCSWITCH_t RCSwitch;
+} RF_BACKEND_t;
+
+static esp_err_t backend_init(RF_BACKEND_t *backend, int gpio) {
+	initSwich(&backend->RCSwitch);
+	enableTransmit(&backend->RCSwitch, gpio);
+	return ESP_OK;
+}
+
+static esp_err_t backend_send(RF_BACKEND_t *backend, const TX_COMMAND_t *command, int repeats) {
+	// RCSwitch only knows its own protocols
+	if (command->raw != NULL) return ESP_ERR_NOT_SUPPORTED;
+	setRepeatTransmit(&backend->RCSwitch, repeats);
+	setProtocol(&backend->RCSwitch, command->protocol);
+	if (command->pulse_length) setPulseLength(&backend->RCSwitch, command->pulse_length);
+	sendCode(&backend->RCSwitch, command->code, command->bitlength);
+	return ESP_OK;
+}
+#endif
+
+static void complete(const TX_COMMAND_t *command, esp_err_t status, bool replaced, int64_t queued_us, int64_t start_us, int64_t end_us) {
+	if (command->reply == NULL) return;
+	TX_RESULT_t result = {
+		.status = status,
+		.replaced = replaced,
+		.wait_us = start_us - queued_us,
+		.air_us = end_us - start_us,
+		.context = command->context,
+	};
+	if (xQueueSend(command->reply, &result, pdMS_TO_TICKS(TX_REPLY_WAIT_MS)) != pdTRUE) {
+		ESP_LOGE(TAG, "Reply queue full, result of channel %d dropped", command->channel);
+	}
+}
+
+// Add the request to the pending list, or replace the pending request for the same channel
+static void pending_add(const TX_REQUEST_t *request) {
+	if (request->command.channel >= 0) {
+		for (int i=0;i<s_npending;i++) {
+			TX_COMMAND_t *pending = &s_pending[i].command;
+			if (pending->channel != request->command.channel) continue;
+			// Keep the place and the time of the first request, so the channel is not starved
+			ESP_LOGI(TAG, "channel %d: the pending command is replaced", pending->channel);
+			int64_t now_us = esp_timer_get_time();
+			complete(pending, ESP_OK, true, s_pending[i].queued_us, now_us, now_us);
+			*pending = request->command;
+			s_pending[i].queued_us = request->queued_us;
+			return;
+		}
+	}
+	s_pending[s_npending++] = *request;
+}
+
+// Ticks left until the period from the start has elapsed
+static TickType_t remaining(TickType_t start, TickType_t period) {
+	TickType_t elapsed = xTaskGetTickCount() - start;
+	return elapsed >= period ? 0 : period - elapsed;
+}
+
+// Only this task drives the GPIO, so frames are never interleaved
+static void transmitter_task(void *pvParameters) {
+	int gpio = (int)pvParameters;
+	ESP_LOGI(TAG, "Start gpio=%d", gpio);
+
+	// Initialize RF
+	RF_BACKEND_t backend;
+	esp_err_t err = backend_init(&backend, gpio);
+	if (err != ESP_OK) {
+		ESP_LOGE(TAG, "backend_init fail (%s)", esp_err_to_name(err));
+		vTaskDelete(NULL);
+	}
+
+	const TickType_t window = pdMS_TO_TICKS(CONFIG_RF_TX_COALESCE_MS);
+	const TickType_t gap = pdMS_TO_TICKS(CONFIG_RF_TX_GAP_MS);
+	TickType_t sent = xTaskGetTickCount() - gap;
+	TX_REQUEST_t request;
+	while(1) {
+		if (s_npending == 0) {
+			xQueueReceive(s_tx_queue, &request, portMAX_DELAY);
+			pending_add(&request);
+		}
+
+		// The command may ask for a longer silence than the gap
+		TickType_t silence = pdMS_TO_TICKS(s_pending[0].command.delay_ms);
+		if (silence < gap) silence = gap;
+
+		// Collect the requests until the window of the oldest one and the silence after the last frame have passed
+		while (s_npending < CONFIG_RF_TX_QUEUE_LENGTH) {
+			TickType_t wait = remaining(s_pending[0].queued, window);
+			TickType_t wait_gap = remaining(sent, silence);
+			if (wait < wait_gap) wait = wait_gap;
+			if (xQueueReceive(s_tx_queue, &request, wait) != pdTRUE) break;
+			pending_add(&request);
+		}
+		// The pending list may have filled up before the silence
+		TickType_t wait_gap = remaining(sent, silence);
+		if (wait_gap) vTaskDelay(wait_gap);
+
+		TX_COMMAND_t command = s_pending[0].command;
+		int64_t queued_us = s_pending[0].queued_us;
+		s_npending--;
+		memmove(&s_pending[0], &s_pending[1], s_npending * sizeof(TX_REQUEST_t));
+
+		esp_err_t status = ESP_OK;
+		int64_t start_us = esp_timer_get_time();
+		if (command.raw == NULL && command.waveform == NULL && (command.bitlength == 0 || command.bitlength > 32 || command.protocol == 0)) {
+			ESP_LOGE(TAG, "Invalid code %"PRIu32" bitlength=%u protocol=%u", command.code, command.bitlength, command.protocol);
+			status = ESP_ERR_INVALID_ARG;
+		} else {
+			if (command.raw != NULL) {
+				ESP_LOGI(TAG, "raw durations=%u levels=%u", command.raw->count, command.raw->nlevel);
+			} else {
+				ESP_LOGI(TAG, "code=%"PRIu32" bitlength=%u protocol=%u", command.code, command.bitlength, command.protocol);
+			}
+			status = backend_send(&backend, &command, command.repeats ? command.repeats : CONFIG_RF_TX_REPEAT);
+			if (status != ESP_OK) ESP_LOGE(TAG, "backend_send fail (%s)", esp_err_to_name(status));
+		}
+		sent = xTaskGetTickCount();
+		complete(&command, status, false, queued_us, start_us, esp_timer_get_time());
+	}
+	vTaskDelete(NULL);
+}
+
+esp_err_t transmitter_start(int gpio) {
+#if CONFIG_RF_TX_VERIFY
+	// Listen to our own frames
+	esp_err_t err = receiver_start(CONFIG_RF_TX_VERIFY_GPIO);
+	if (err != ESP_OK) return err;
+#endif
+	s_tx_queue = xQueueCreate(CONFIG_RF_TX_QUEUE_LENGTH, sizeof(TX_REQUEST_t));
+	if (s_tx_queue == NULL) {
+		ESP_LOGE(TAG, "xQueueCreate fail");
+		return ESP_ERR_NO_MEM;
+	}
+	if (xTaskCreate(transmitter_task, "TX", 1024*4, (void *)gpio, 3, NULL) != pdPASS) {
+		ESP_LOGE(TAG, "xTaskCreate fail");
+		return ESP_ERR_NO_MEM;
+	}
+	return ESP_OK;
+}
+
+esp_err_t transmitter_send(const TX_COMMAND_t *command, TickType_t wait) {
+	if (s_tx_queue == NULL) return ESP_ERR_INVALID_STATE;
+	TX_REQUEST_t request = {
+		.command = *command,
+		.queued = xTaskGetTickCount(),
+		.queued_us = esp_timer_get_time(),
+	};
+	if (xQueueSend(s_tx_queue, &request, wait) != pdTRUE) {
+		ESP_LOGE(TAG, "transmit queue is full");
+		return ESP_ERR_TIMEOUT;
+	}
+	return ESP_OK;
+}
+
+esp_err_t transmitter_send_wait(const TX_COMMAND_t *command, TickType_t wait, TX_RESULT_t *result) {
+	// The reply queue lives on the stack of the caller
+	StaticQueue_t reply_buffer;
+	uint8_t reply_storage[sizeof(TX_RESULT_t)];
+	TX_COMMAND_t _command = *command;
+	_command.reply = xQueueCreateStatic(1, sizeof(TX_RESULT_t), reply_storage, &reply_buffer);
+
+	TX_RESULT_t _result = {};
+	_result.status = transmitter_send(&_command, wait);
+	if (_result.status == ESP_OK) {
+		// Once queued, the command is always completed
+		xQueueReceive(_command.reply, &_result, portMAX_DELAY);
+	}
+	vQueueDelete(_command.reply);
+	if (result != NULL) *result = _result;
+	return _result.status;
+}
@@ -0,0 +1,42 @@
+#ifndef TRANSMITTER_H
+#define TRANSMITTER_H
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "esp_err.h"
+#include "rfcodec.h"
+
+typedef struct {
+	uint32_t code;
+	uint16_t bitlength;
+	uint16_t protocol;
+	uint16_t pulse_length; // 0 means the default of the protocol
+	uint16_t repeats; // 0 means CONFIG_RF_TX_REPEAT
+	int16_t channel; // Index of the channel. The latest command for the same channel wins. -1 for no coalescing.
+	uint16_t delay_ms; // Silence after the previous command when longer than CONFIG_RF_TX_GAP_MS
+	const RF_RAW_CODE_t *raw; // Raw code instead of the protocol. Must live until the command is completed.
+	const RF_WAVEFORM_t *waveform; // Frame encoded in advance, or NULL. Must live until the command is completed.
+	QueueHandle_t reply; // Receives TX_RESULT_t when the command is completed. Can be NULL. The result is dropped when it is full.
+	void *context; // Returned in TX_RESULT_t to tell the commands sharing one reply queue apart
+} TX_COMMAND_t;
+
+typedef struct {
+	esp_err_t status;
+	bool replaced; // Replaced by a later command for the same channel and not sent
+	uint32_t wait_us; // From queued until the transmission started
+	uint32_t air_us; // Duration of the transmission
+	void *context; // context of the command
+} TX_RESULT_t;
+
+// Start the RF transmitter task which owns the GPIO
+esp_err_t transmitter_start(int gpio);
+
+// Queue the command without waiting for the completion.
+// Commands for the same channel waiting for the transmission are coalesced into the latest one.
+// The replaced command is completed with ESP_OK without being sent.
+esp_err_t transmitter_send(const TX_COMMAND_t *command, TickType_t wait);
+
+// Queue the command and wait for the completion. result can be NULL.
+esp_err_t transmitter_send_wait(const TX_COMMAND_t *command, TickType_t wait, TX_RESULT_t *result);
+
+#endif /* TRANSMITTER_H */
@@ -96,6 +96,19 @@ time_t _mkgmtime(struct tm* tm);
 #endif /* __MINGW32__ */
 
 /* function definitions */
+#if defined(ESP8266) || defined(ESP_PLATFORM) || defined(TARGET_LIKE_MBED)
+/* days since 1970-01-01 of the proleptic Gregorian date, month is 1-12 */
+/* http://howardhinnant.github.io/date_algorithms.html#days_from_civil */
+static long long cron_days_from_civil(long long y, int m, int d) {
+    y -= m <= 2;
+    long long era = (y >= 0 ? y : y - 399) / 400;
+    unsigned int yoe = (unsigned int) (y - era * 400);
+    unsigned int doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    unsigned int doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + (long long) doe - 719468;
+}
+#endif
+
 time_t cron_mktime_gm(struct tm* tm) {
 #if defined(_WIN32)
 /* http://stackoverflow.com/a/22557778 */
@@ -104,23 +117,23 @@ time_t cron_mktime_gm(struct tm* tm) {
 /* https://www.nongnu.org/avr-libc/user-manual/group__avr__time.html */
     return mk_gmtime(tm);
 #elif defined(ESP8266) || defined(ESP_PLATFORM) || defined(TARGET_LIKE_MBED)
-    /* https://linux.die.net/man/3/timegm */
-    /* http://www.catb.org/esr/time-programming/ */
-    /* portable version of timegm() */
-    time_t ret;
-    char *tz;
-    tz = getenv("TZ");
-    if (tz)
-        tz = strdup(tz);
-    setenv("TZ", "UTC+0", 1);
-    tzset();
-    ret = mktime(tm);
-    if (tz) {
-        setenv("TZ", tz, 1);
-        free(tz);
-    } else
-        unsetenv("TZ");
-    tzset();
+    /* portable version of timegm() that does not switch the TZ environment
+       variable (setenv + tzset + mktime on every call is very slow) */
+    long long year = tm->tm_year + 1900LL;
+    int mon = tm->tm_mon;
+    year += mon / 12;
+    mon %= 12;
+    if (mon < 0) {
+        mon += 12;
+        year -= 1;
+    }
+    /* the other fields may be out of range, they are just added up */
+    long long secs = cron_days_from_civil(year, mon + 1, 1) + (tm->tm_mday - 1);
+    secs = secs * 86400LL + tm->tm_hour * 3600LL + tm->tm_min * 60LL + tm->tm_sec;
+    time_t ret = (time_t) secs;
+    if ((long long) ret != secs) return CRON_INVALID_INSTANT;
+    /* normalize the fields and set tm_wday and tm_yday like mktime() does */
+    if (!gmtime_r(&ret, tm)) return CRON_INVALID_INSTANT;
     return ret;
 #elif defined(ANDROID)
     /* https://github.com/adobe/chromium/blob/cfe5bf0b51b1f6b9fe239c2a3c2f2364da9967d7/base/os_compat_android.cc#L20 */
@@ -238,14 +251,43 @@ static char* strdupl(const char* str, size_t len) {
     return res;
 }
 
+/* index of the lowest/highest set bit of a non-zero byte */
+#if defined(__GNUC__)
+#define cron_lowest_bit(byte) ((unsigned int) __builtin_ctz(byte))
+#define cron_highest_bit(byte) ((unsigned int) (31 - __builtin_clz(byte)))
+#else /* __GNUC__ */
+static unsigned int cron_lowest_bit(uint8_t byte) {
+    unsigned int i = 0;
+    while (!(byte & 1)) {
+        byte >>= 1;
+        i++;
+    }
+    return i;
+}
+
+static unsigned int cron_highest_bit(uint8_t byte) {
+    unsigned int i = 0;
+    while (byte >>= 1) {
+        i++;
+    }
+    return i;
+}
+#endif /* __GNUC__ */
+
 static unsigned int next_set_bit(uint8_t* bits, unsigned int max, unsigned int from_index, int* notfound) {
     unsigned int i;
     if (!bits) {
         *notfound = 1;
         return 0;
     }
-    for (i = from_index; i < max; i++) {
-        if (cron_get_bit(bits, i)) return i;
+    /* scan a whole byte at a time, masking the bits below from_index */
+    for (i = from_index; i < max; i = (i & ~7u) + 8) {
+        uint8_t byte = (uint8_t) (bits[i / 8] & (0xFF << (i % 8)));
+        if (byte) {
+            unsigned int found = (i & ~7u) + cron_lowest_bit(byte);
+            if (found < max) return found;
+            break;
+        }
     }
     *notfound = 1;
     return 0;
@@ -302,9 +344,9 @@ static int add_to_field(struct tm* calendar, int field, int val) {
 }
 
 /**
- * Reset the calendar setting all the fields provided to zero.
+ * Set the field to its minimum value, without normalizing the calendar.
  */
-static int reset_min(struct tm* calendar, int field) {
+static int set_min_value(struct tm* calendar, int field) {
     if (!calendar || -1 == field) {
         return 1;
     }
@@ -333,8 +375,17 @@ static int reset_min(struct tm* calendar, int field) {
     default:
         return 1; /* unknown field */
     }
-    time_t res = cron_mktime(calendar);
-    if (CRON_INVALID_INSTANT == res) {
+    return 0;
+}
+
+/**
+ * Reset the calendar setting all the fields provided to zero.
+ */
+static int reset_min(struct tm* calendar, int field) {
+    int res = set_min_value(calendar, field);
+    if (0 != res) return res;
+    time_t t = cron_mktime(calendar);
+    if (CRON_INVALID_INSTANT == t) {
         return 1;
     }
     return 0;
@@ -343,15 +394,21 @@ static int reset_min(struct tm* calendar, int field) {
 static int reset_all_min(struct tm* calendar, int* fields) {
     int i;
     int res = 0;
+    int count = 0;
     if (!calendar || !fields) {
         return 1;
     }
     for (i = 0; i < CRON_CF_ARR_LEN; i++) {
         if (-1 != fields[i]) {
-            res = reset_min(calendar, fields[i]);
+            res = set_min_value(calendar, fields[i]);
             if (0 != res) return res;
+            count++;
         }
     }
+    /* normalize the calendar once for all the fields */
+    if (count > 0 && CRON_INVALID_INSTANT == cron_mktime(calendar)) {
+        return 1;
+    }
     return 0;
 }
 
@@ -391,6 +448,21 @@ static int set_field(struct tm* calendar, int field, int val) {
     return 0;
 }
 
+static int last_day_of_month(int month, int year) {
+    /* calculated rather than normalized with mktime, which works in local time */
+    static const int days[] = { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+    year += 1900 + month / 12;
+    month %= 12;
+    if (month < 0) {
+        month += 12;
+        year--;
+    }
+    if (1 == month && ((0 == year % 4 && 0 != year % 100) || 0 == year % 400)) {
+        return 29;
+    }
+    return days[month];
+}
+
 /**
  * Search the bits provided for the next set bit after the value provided,
  * and reset the calendar.
@@ -409,6 +481,11 @@ static unsigned int find_next(uint8_t* bits, unsigned int max, unsigned int valu
         next_value = next_set_bit(bits, max, 0, &notfound);
     }
     if (notfound || next_value != value) {
+        if (CRON_CF_MONTH == field) {
+            /* keep the day inside the later month, it would spill over into the following one */
+            int last_day = last_day_of_month(next_value, calendar->tm_year);
+            if (calendar->tm_mday > last_day) calendar->tm_mday = last_day;
+        }
         err = set_field(calendar, field, next_value);
         if (err) goto return_error;
         err = reset_all_min(calendar, lower_orders);
@@ -443,10 +520,9 @@ static unsigned int find_next_day(struct tm* calendar, uint8_t* days_of_month, u
 static int do_next(cron_expr* expr, struct tm* calendar, unsigned int dot) {
     int i;
     int res = 0;
-    int* resets = NULL;
-    int* empty_list = NULL;
+    int resets[CRON_CF_ARR_LEN];
+    int empty_list[CRON_CF_ARR_LEN];
     unsigned int second = 0;
-    unsigned int update_second = 0;
     unsigned int minute = 0;
     unsigned int update_minute = 0;
     unsigned int hour = 0;
@@ -454,24 +530,22 @@ static int do_next(cron_expr* expr, struct tm* calendar, unsigned int dot) {
     unsigned int day_of_week = 0;
     unsigned int day_of_month = 0;
     unsigned int update_day_of_month = 0;
+    int day_of_year = 0;
+    int year = 0;
     unsigned int month = 0;
     unsigned int update_month = 0;
 
-    resets = (int*) cron_malloc(CRON_CF_ARR_LEN * sizeof(int));
-    if (!resets) goto return_result;
-    empty_list = (int*) cron_malloc(CRON_CF_ARR_LEN * sizeof(int));
-    if (!empty_list) goto return_result;
     for (i = 0; i < CRON_CF_ARR_LEN; i++) {
         resets[i] = -1;
         empty_list[i] = -1;
     }
 
     second = calendar->tm_sec;
-    update_second = find_next(expr->seconds, CRON_MAX_SECONDS, second, calendar, CRON_CF_SECOND, CRON_CF_MINUTE, empty_list, &res);
+    find_next(expr->seconds, CRON_MAX_SECONDS, second, calendar, CRON_CF_SECOND, CRON_CF_MINUTE, empty_list, &res);
     if (0 != res) goto return_result;
-    if (second == update_second) {
-        push_to_fields_arr(resets, CRON_CF_SECOND);
-    }
+    /* the seconds found here only hold for the current minute, reset them
+       whenever a higher field moves, even if they did not match at first */
+    push_to_fields_arr(resets, CRON_CF_SECOND);
 
     minute = calendar->tm_min;
     update_minute = find_next(expr->minutes, CRON_MAX_MINUTES, minute, calendar, CRON_CF_MINUTE, CRON_CF_HOUR_OF_DAY, resets, &res);
@@ -495,9 +569,13 @@ static int do_next(cron_expr* expr, struct tm* calendar, unsigned int dot) {
 
     day_of_week = calendar->tm_wday;
     day_of_month = calendar->tm_mday;
+    day_of_year = calendar->tm_yday;
+    year = calendar->tm_year;
     update_day_of_month = find_next_day(calendar, expr->days_of_month, day_of_month, expr->days_of_week, day_of_week, resets, &res);
     if (0 != res) goto return_result;
-    if (day_of_month == update_day_of_month) {
+    /* the day search may end on the same day of a different month,
+       the lower fields then have to be searched again */
+    if (day_of_month == update_day_of_month && day_of_year == calendar->tm_yday && year == calendar->tm_year) {
         push_to_fields_arr(resets, CRON_CF_DAY_OF_MONTH);
     } else {
         res = do_next(expr, calendar, dot);
@@ -518,15 +596,6 @@ static int do_next(cron_expr* expr, struct tm* calendar, unsigned int dot) {
     goto return_result;
 
     return_result:
-    if (!resets || !empty_list) {
-        res = -1;
-    }
-    if (resets) {
-        cron_free(resets);
-    }
-    if (empty_list) {
-        cron_free(empty_list);
-    }
     return res;
 }
 
@@ -959,6 +1028,28 @@ void cron_parse_expr(const char* expression, cron_expr* target, const char** err
     free_splitted(fields, len);
 }
 
+/**
+ * Calculates the next 'fire' date from the date held by the calendar.
+ * The calendar is left at the calculated date.
+ * 'original' is the date the search started from, it is never returned.
+ */
+static time_t next_from_calendar(cron_expr* expr, struct tm* calendar, time_t original) {
+    int res = do_next(expr, calendar, calendar->tm_year);
+    if (0 != res) return CRON_INVALID_INSTANT;
+
+    time_t calculated = cron_mktime(calendar);
+    if (CRON_INVALID_INSTANT == calculated) return CRON_INVALID_INSTANT;
+    if (calculated == original) {
+        /* We arrived at the original timestamp - round up to the next whole second and try again... */
+        res = add_to_field(calendar, CRON_CF_SECOND, 1);
+        if (0 != res) return CRON_INVALID_INSTANT;
+        res = do_next(expr, calendar, calendar->tm_year);
+        if (0 != res) return CRON_INVALID_INSTANT;
+        calculated = cron_mktime(calendar);
+    }
+    return calculated;
+}
+
 time_t cron_next(cron_expr* expr, time_t date) {
     /*
      The plan:
@@ -986,20 +1077,100 @@ time_t cron_next(cron_expr* expr, time_t date) {
     time_t original = cron_mktime(calendar);
     if (CRON_INVALID_INSTANT == original) return CRON_INVALID_INSTANT;
 
-    int res = do_next(expr, calendar, calendar->tm_year);
-    if (0 != res) return CRON_INVALID_INSTANT;
+    return next_from_calendar(expr, calendar, original);
+}
 
-    time_t calculated = cron_mktime(calendar);
-    if (CRON_INVALID_INSTANT == calculated) return CRON_INVALID_INSTANT;
-    if (calculated == original) {
-        /* We arrived at the original timestamp - round up to the next whole second and try again... */
-        res = add_to_field(calendar, CRON_CF_SECOND, 1);
-        if (0 != res) return CRON_INVALID_INSTANT;
-        res = do_next(expr, calendar, calendar->tm_year);
-        if (0 != res) return CRON_INVALID_INSTANT;
+#ifndef CRON_USE_LOCAL_TIME
+/**
+ * Finds the next 'fire' date within the same day as the calendar, which only
+ * needs the seconds, minutes and hours bitsets and no calendar normalization.
+ * The calendar must hold the 'fire' date 'date'.
+ * Returns 1 and updates the calendar and 'date' when found.
+ */
+static int next_in_same_day(cron_expr* expr, struct tm* calendar, time_t* date) {
+    int notfound = 0;
+    unsigned int second = next_set_bit(expr->seconds, CRON_MAX_SECONDS, calendar->tm_sec + 1, &notfound);
+    if (!notfound) {
+        *date += (int) second - calendar->tm_sec;
+        calendar->tm_sec = second;
+        return 1;
+    }
+    notfound = 0;
+    second = next_set_bit(expr->seconds, CRON_MAX_SECONDS, 0, &notfound);
+    if (notfound) return 0;
+    unsigned int minute = next_set_bit(expr->minutes, CRON_MAX_MINUTES, calendar->tm_min + 1, &notfound);
+    if (!notfound) {
+        *date += ((int) minute - calendar->tm_min) * 60 + ((int) second - calendar->tm_sec);
+        calendar->tm_min = minute;
+        calendar->tm_sec = second;
+        return 1;
     }
+    notfound = 0;
+    minute = next_set_bit(expr->minutes, CRON_MAX_MINUTES, 0, &notfound);
+    if (notfound) return 0;
+    unsigned int hour = next_set_bit(expr->hours, CRON_MAX_HOURS, calendar->tm_hour + 1, &notfound);
+    if (!notfound) {
+        *date += ((int) hour - calendar->tm_hour) * 3600 + ((int) minute - calendar->tm_min) * 60 + ((int) second - calendar->tm_sec);
+        calendar->tm_hour = hour;
+        calendar->tm_min = minute;
+        calendar->tm_sec = second;
+        return 1;
+    }
+    return 0;
+}
+#endif /* CRON_USE_LOCAL_TIME */
 
-    return cron_mktime(calendar);
+/**
+ * Calculates the 'fire' date following 'date', which the calendar holds.
+ */
+static time_t next_from_fire_date(cron_expr* expr, struct tm* calendar, time_t date) {
+#ifndef CRON_USE_LOCAL_TIME
+    /* the same day can be searched without touching the calendar */
+    if (next_in_same_day(expr, calendar, &date)) return date;
+#endif /* CRON_USE_LOCAL_TIME */
+    if (0 != add_to_field(calendar, CRON_CF_SECOND, 1)) return CRON_INVALID_INSTANT;
+    return next_from_calendar(expr, calendar, date);
+}
+
+int cron_next_n(cron_expr* expr, time_t date, time_t* out, int n) {
+    int count = 0;
+    if (!expr || !out || n <= 0) return 0;
+    struct tm calval;
+    memset(&calval, 0, sizeof(struct tm));
+    struct tm* calendar = cron_time(&date, &calval);
+    if (!calendar) return 0;
+    time_t original = cron_mktime(calendar);
+    if (CRON_INVALID_INSTANT == original) return 0;
+
+    /* the calendar is carried over from one 'fire' date to the next */
+    time_t calculated = next_from_calendar(expr, calendar, original);
+    while (CRON_INVALID_INSTANT != calculated) {
+        out[count++] = calculated;
+        if (count >= n) break;
+        calculated = next_from_fire_date(expr, calendar, calculated);
+    }
+    return count;
+}
+
+int cron_count_between(cron_expr* expr, time_t from, time_t to) {
+    int count = 0;
+    if (!expr) return -1;
+    if (to <= from) return 0;
+    struct tm calval;
+    memset(&calval, 0, sizeof(struct tm));
+    struct tm* calendar = cron_time(&from, &calval);
+    if (!calendar) return -1;
+    time_t original = cron_mktime(calendar);
+    if (CRON_INVALID_INSTANT == original) return -1;
+
+    /* the calendar is carried over from one 'fire' date to the next */
+    time_t calculated = next_from_calendar(expr, calendar, original);
+    while (CRON_INVALID_INSTANT != calculated && calculated <= to) {
+        if (count == INT_MAX) break;
+        count++;
+        calculated = next_from_fire_date(expr, calendar, calculated);
+    }
+    return count;
 }
 
 
@@ -1011,31 +1182,22 @@ static unsigned int prev_set_bit(uint8_t* bits, int from_index, int to_index, in
         *notfound = 1;
         return 0;
     }
-    for (i = from_index; i >= to_index; i--) {
-        if (cron_get_bit(bits, i)) return i;
+    /* scan a whole byte at a time, masking the bits above from_index and below to_index */
+    for (i = from_index; i >= to_index; i = (i & ~7) - 1) {
+        uint8_t byte = (uint8_t) (bits[i / 8] & (0xFF >> (7 - i % 8)));
+        if (i / 8 == to_index / 8) {
+            byte &= (uint8_t) (0xFF << (to_index % 8));
+        }
+        if (byte) return (unsigned int) (i & ~7) + cron_highest_bit(byte);
     }
     *notfound = 1;
     return 0;
 }
 
-static int last_day_of_month(int month, int year) {
-    struct tm cal;
-    time_t t;
-    memset(&cal,0,sizeof(cal));
-    cal.tm_sec=0;
-    cal.tm_min=0;
-    cal.tm_hour=0;
-    cal.tm_mon = month+1;
-    cal.tm_mday = 0;
-    cal.tm_year=year;
-    t=mktime(&cal);
-    return gmtime(&t)->tm_mday;
-}
-
 /**
- * Reset the calendar setting all the fields provided to zero.
+ * Set the field to its maximum value, without normalizing the calendar.
  */
-static int reset_max(struct tm* calendar, int field) {
+static int set_max_value(struct tm* calendar, int field) {
     if (!calendar || -1 == field) {
         return 1;
     }
@@ -1065,8 +1227,17 @@ static int reset_max(struct tm* calendar, int field) {
     default:
         return 1; /* unknown field */
     }
-    time_t res = cron_mktime(calendar);
-    if (CRON_INVALID_INSTANT == res) {
+    return 0;
+}
+
+/**
+ * Reset the calendar setting all the fields provided to zero.
+ */
+static int reset_max(struct tm* calendar, int field) {
+    int res = set_max_value(calendar, field);
+    if (0 != res) return res;
+    time_t t = cron_mktime(calendar);
+    if (CRON_INVALID_INSTANT == t) {
         return 1;
     }
     return 0;
@@ -1075,15 +1246,21 @@ static int reset_max(struct tm* calendar, int field) {
 static int reset_all_max(struct tm* calendar, int* fields) {
     int i;
     int res = 0;
+    int count = 0;
     if (!calendar || !fields) {
         return 1;
     }
     for (i = 0; i < CRON_CF_ARR_LEN; i++) {
         if (-1 != fields[i]) {
-            res = reset_max(calendar, fields[i]);
+            res = set_max_value(calendar, fields[i]);
             if (0 != res) return res;
+            count++;
         }
     }
+    /* normalize the calendar once for all the fields */
+    if (count > 0 && CRON_INVALID_INSTANT == cron_mktime(calendar)) {
+        return 1;
+    }
     return 0;
 }
 
@@ -1105,6 +1282,11 @@ static unsigned int find_prev(uint8_t* bits, unsigned int max, unsigned int valu
         next_value = prev_set_bit(bits, max - 1, value, &notfound);
     }
     if (notfound || next_value != value) {
+        if (CRON_CF_MONTH == field) {
+            /* keep the day inside the earlier month, it would spill over into the following one */
+            int last_day = last_day_of_month(next_value, calendar->tm_year);
+            if (calendar->tm_mday > last_day) calendar->tm_mday = last_day;
+        }
         err = set_field(calendar, field, next_value);
         if (err) goto return_error;
         err = reset_all_max(calendar, lower_orders);
@@ -1139,10 +1321,9 @@ static unsigned int find_prev_day(struct tm* calendar, uint8_t* days_of_month, u
 static int do_prev(cron_expr* expr, struct tm* calendar, unsigned int dot) {
     int i;
     int res = 0;
-    int* resets = NULL;
-    int* empty_list = NULL;
+    int resets[CRON_CF_ARR_LEN];
+    int empty_list[CRON_CF_ARR_LEN];
     unsigned int second = 0;
-    unsigned int update_second = 0;
     unsigned int minute = 0;
     unsigned int update_minute = 0;
     unsigned int hour = 0;
@@ -1150,24 +1331,28 @@ static int do_prev(cron_expr* expr, struct tm* calendar, unsigned int dot) {
     unsigned int day_of_week = 0;
     unsigned int day_of_month = 0;
     unsigned int update_day_of_month = 0;
+    int day_of_year = 0;
+    int year = 0;
     unsigned int month = 0;
     unsigned int update_month = 0;
 
-    resets = (int*) cron_malloc(CRON_CF_ARR_LEN * sizeof(int));
-    if (!resets) goto return_result;
-    empty_list = (int*) cron_malloc(CRON_CF_ARR_LEN * sizeof(int));
-    if (!empty_list) goto return_result;
     for (i = 0; i < CRON_CF_ARR_LEN; i++) {
         resets[i] = -1;
         empty_list[i] = -1;
     }
 
+    /* the day search can roll back a whole year without reaching the month
+       check below, so bound the recursion here as well */
+    if (dot - calendar->tm_year > CRON_MAX_YEARS_DIFF) {
+        return -1;
+    }
+
     second = calendar->tm_sec;
-    update_second = find_prev(expr->seconds, CRON_MAX_SECONDS, second, calendar, CRON_CF_SECOND, CRON_CF_MINUTE, empty_list, &res);
+    find_prev(expr->seconds, CRON_MAX_SECONDS, second, calendar, CRON_CF_SECOND, CRON_CF_MINUTE, empty_list, &res);
     if (0 != res) goto return_result;
-    if (second == update_second) {
-        push_to_fields_arr(resets, CRON_CF_SECOND);
-    }
+    /* the seconds found here only hold for the current minute, reset them
+       whenever a higher field moves, even if they did not match at first */
+    push_to_fields_arr(resets, CRON_CF_SECOND);
 
     minute = calendar->tm_min;
     update_minute = find_prev(expr->minutes, CRON_MAX_MINUTES, minute, calendar, CRON_CF_MINUTE, CRON_CF_HOUR_OF_DAY, resets, &res);
@@ -1191,9 +1376,13 @@ static int do_prev(cron_expr* expr, struct tm* calendar, unsigned int dot) {
 
     day_of_week = calendar->tm_wday;
     day_of_month = calendar->tm_mday;
+    day_of_year = calendar->tm_yday;
+    year = calendar->tm_year;
     update_day_of_month = find_prev_day(calendar, expr->days_of_month, day_of_month, expr->days_of_week, day_of_week, resets, &res);
     if (0 != res) goto return_result;
-    if (day_of_month == update_day_of_month) {
+    /* the day search may end on the same day of a different month,
+       the lower fields then have to be searched again */
+    if (day_of_month == update_day_of_month && day_of_year == calendar->tm_yday && year == calendar->tm_year) {
         push_to_fields_arr(resets, CRON_CF_DAY_OF_MONTH);
     } else {
         res = do_prev(expr, calendar, dot);
@@ -1214,15 +1403,6 @@ static int do_prev(cron_expr* expr, struct tm* calendar, unsigned int dot) {
     goto return_result;
 
     return_result:
-    if (!resets || !empty_list) {
-        res = -1;
-    }
-    if (resets) {
-        cron_free(resets);
-    }
-    if (empty_list) {
-        cron_free(empty_list);
-    }
     return res;
 }
 
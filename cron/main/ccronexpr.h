@@ -73,6 +73,35 @@ void cron_parse_expr(const char* expression, cron_expr* target, const char** err
  */
 time_t cron_next(cron_expr* expr, time_t date);
 
+/**
+ * Uses the specified expression to calculate the next 'n' 'fire' dates after
+ * the specified date. The calendar state is carried over from one 'fire' date
+ * to the next, so this is faster than calling 'cron_next' 'n' times.
+ * All dates are processed as UTC (GMT) dates without timezones information,
+ * see 'cron_next'.
+ *
+ * @param expr parsed cron expression to use in next date calculation
+ * @param date start date to start calculation from
+ * @param out array to store 'fire' dates, must hold at least 'n' dates
+ * @param n number of 'fire' dates to calculate
+ * @return number of 'fire' dates stored to 'out', less than 'n' when
+ *         no more 'fire' date can be found or in case of error.
+ */
+int cron_next_n(cron_expr* expr, time_t date, time_t* out, int n);
+
+/**
+ * Uses the specified expression to count the 'fire' dates after
+ * the 'from' date up to and including the 'to' date.
+ * All dates are processed as UTC (GMT) dates without timezones information,
+ * see 'cron_next'.
+ *
+ * @param expr parsed cron expression to use in next date calculation
+ * @param from start date to start counting from (exclusive)
+ * @param to end date to stop counting at (inclusive)
+ * @return number of 'fire' dates in case of success, '-1' in case of error.
+ */
+int cron_count_between(cron_expr* expr, time_t from, time_t to);
+
 /**
  * Uses the specified expression to calculate the previous 'fire' date after
  * the specified date. All dates are processed as UTC (GMT) dates 
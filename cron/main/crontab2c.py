@@ -0,0 +1,196 @@
+#!/usr/bin/env python3
+#
+# Convert crontab into a C header with the parsed cron expressions.
+# The parser follows cron_parse_expr() in ccronexpr.c.
+#
+# usage: crontab2c.py crontab embedded_crontab.h
+#
+
+import re
+import sys
+
+DAYS = ["SUN", "MON", "TUE", "WED", "THU", "FRI", "SAT"]
+MONTHS = ["FOO", "JAN", "FEB", "MAR", "APR", "MAY", "JUN", "JUL", "AUG", "SEP", "OCT", "NOV", "DEC"]
+
+# Same as cron_expr in ccronexpr.h
+FIELDS = [("seconds", 8), ("minutes", 8), ("hours", 3), ("days_of_week", 1), ("days_of_month", 4), ("months", 2)]
+
+# Same as EMBEDDED_CRON_t in main.c, less the terminator
+TASK_NAME_MAX = 31
+DATE_TIME_MAX = 63
+
+
+class CronError(Exception):
+    pass
+
+
+def split_str(value, delimiter):
+    # Blanks are removed and empty parts are dropped like split_str()
+    parts = [re.sub(r"\s", "", part) for part in value.split(delimiter)]
+    return [part for part in parts if part]
+
+
+def parse_uint(value, message):
+    if not re.fullmatch(r"[+-]?[0-9]+", value) or int(value) < 0 or int(value) > 0x7fffffff:
+        raise CronError(message)
+    return int(value)
+
+
+def get_range(field, low, high):
+    if field == "*":
+        start, end = low, high - 1
+    elif "-" not in field:
+        start = end = parse_uint(field, "Unsigned integer parse error 1")
+    else:
+        parts = split_str(field, "-")
+        if len(parts) != 2:
+            raise CronError("Specified range requires two fields")
+        start = parse_uint(parts[0], "Unsigned integer parse error 2")
+        end = parse_uint(parts[1], "Unsigned integer parse error 3")
+    if start >= high or end >= high:
+        raise CronError("Specified range exceeds maximum")
+    if start < low or end < low:
+        raise CronError("Specified range is less than minimum")
+    if start > end:
+        raise CronError("Specified range start exceeds range end")
+    return start, end
+
+
+def number_hits(value, low, high):
+    fields = split_str(value, ",")
+    if not fields:
+        raise CronError("Comma split error")
+    hits = set()
+    for field in fields:
+        if "/" not in field:
+            start, end = get_range(field, low, high)
+            hits.update(range(start, end + 1))
+            continue
+        split = split_str(field, "/")
+        if len(split) != 2:
+            raise CronError("Incrementer must have two fields")
+        start, end = get_range(split[0], low, high)
+        if "-" not in split[0]:
+            end = high - 1
+        delta = parse_uint(split[1], "Unsigned integer parse error 4")
+        if delta == 0:
+            raise CronError("Incrementer may not be zero")
+        hits.update(range(start, end + 1, delta))
+    return hits
+
+
+def replace_ordinals(value, names):
+    value = value.upper()
+    for index, name in enumerate(names):
+        value = value.replace(name, str(index))
+    return value
+
+
+def parse_expr(expression):
+    fields = split_str(expression, " ")
+    if len(fields) != 6:
+        raise CronError("Invalid number of fields, expression must consist of 6 fields")
+    seconds = number_hits(fields[0], 0, 60)
+    minutes = number_hits(fields[1], 0, 60)
+    hours = number_hits(fields[2], 0, 24)
+    days_of_month = number_hits("*" if fields[3] == "?" else fields[3], 1, 32)
+    months = {month - 1 for month in number_hits(replace_ordinals(fields[4], MONTHS), 1, 13)}
+    days_of_week = number_hits(replace_ordinals("*" if fields[5] == "?" else fields[5], DAYS), 0, 8)
+    if 7 in days_of_week:
+        # Sunday can be represented as 0 or 7
+        days_of_week = (days_of_week - {7}) | {0}
+    hits = {
+        "seconds": seconds,
+        "minutes": minutes,
+        "hours": hours,
+        "days_of_week": days_of_week,
+        "days_of_month": days_of_month,
+        "months": months,
+    }
+    result = []
+    for name, size in FIELDS:
+        bits = [0] * size
+        for hit in hits[name]:
+            bits[hit // 8] |= 1 << (hit % 8)
+        result.append(bits)
+    return result
+
+
+def read_crontab(file_name):
+    entries = []
+    errors = 0
+    with open(file_name, encoding="utf-8") as f:
+        for line_number, line in enumerate(f, 1):
+            line = line.strip()
+            if line == "" or line.startswith("#"):
+                continue
+            items = line.split()
+            if len(items) < 6:
+                print(f"{file_name}:{line_number}: cron expression must consist of 6 fields [{line}]", file=sys.stderr)
+                errors += 1
+                continue
+            if len(items) < 7:
+                print(f"{file_name}:{line_number}: task name not found [{line}]", file=sys.stderr)
+                errors += 1
+                continue
+            expression = " ".join(items[:6])
+            task_name = items[6]
+            if len(expression) > DATE_TIME_MAX:
+                print(f"{file_name}:{line_number}: cron expression too long [{expression}]", file=sys.stderr)
+                errors += 1
+                continue
+            if len(task_name) > TASK_NAME_MAX:
+                print(f"{file_name}:{line_number}: task name too long [{task_name}]", file=sys.stderr)
+                errors += 1
+                continue
+            try:
+                entries.append((expression, task_name, parse_expr(expression)))
+            except CronError as e:
+                print(f"{file_name}:{line_number}: {e} [{expression}]", file=sys.stderr)
+                errors += 1
+    if errors:
+        sys.exit(1)
+    return entries
+
+
+def c_string(value):
+    return '"' + value.replace("\\", "\\\\").replace('"', '\\"') + '"'
+
+
+def write_header(file_name, source, entries):
+    lines = []
+    lines.append(f"// Generated from {source} by crontab2c.py. Do not edit.")
+    lines.append("")
+    lines.append(f"#define EMBEDDED_CRONTAB_SIZE {len(entries)}")
+    lines.append("")
+    lines.append("static const EMBEDDED_CRON_t embedded_crontab[] = {")
+    for expression, task_name, bits in entries:
+        fields = ", ".join("{" + ",".join(f"0x{byte:02x}" for byte in field) + "}" for field in bits)
+        lines.append(f"\t{{ {{ {fields} }}, {c_string(task_name)}, {c_string(expression)} }},")
+    if not entries:
+        # An array can not be empty
+        lines.append("\t{ { {0} }, \"\", \"\" },")
+    lines.append("};")
+    text = "\n".join(lines) + "\n"
+
+    # Keep the timestamp when nothing has been changed
+    try:
+        with open(file_name, encoding="utf-8") as f:
+            if f.read() == text:
+                return
+    except OSError:
+        pass
+    with open(file_name, "w", encoding="utf-8") as f:
+        f.write(text)
+
+
+def main():
+    if len(sys.argv) != 3:
+        print(f"usage: {sys.argv[0]} crontab header", file=sys.stderr)
+        sys.exit(2)
+    entries = read_crontab(sys.argv[1])
+    write_header(sys.argv[2], sys.argv[1].replace("\\", "/").split("/")[-1], entries)
+
+
+if __name__ == "__main__":
+    main()
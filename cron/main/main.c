@@ -11,6 +11,8 @@
 #include <stdio.h>
 #include <inttypes.h>
 #include <string.h>
+#include <sys/time.h>
+#include <sys/stat.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/event_groups.h"
@@ -24,8 +26,18 @@
 #include "esp_sntp.h"
 
 #include "ccronexpr.h"
+#include "tzcache.h"
 
-#include "RCSwitch.h"
+#include "transmitter.h"
+#include "channel.h"
+#if CONFIG_CRON_UPLOAD
+#include "upload.h"
+#endif
+
+// The crontab on SPIFFS can be replaced without reboot
+#if CONFIG_CRON_RELOAD_INTERVAL || CONFIG_CRON_UPLOAD
+#define CRON_RELOAD 1
+#endif
 
 /* FreeRTOS event group to signal when we are connected*/
 static EventGroupHandle_t s_wifi_event_group;
@@ -40,6 +52,14 @@ static const char *TAG = "MAIN";
 
 static int s_retry_num = 0;
 
+/* Task running the cron scheduler. Notified when the system time is changed. */
+static TaskHandle_t s_cron_task = NULL;
+
+#if CRON_RELOAD
+/* Set when a new crontab has been uploaded */
+static volatile bool s_reload_requested = false;
+#endif
+
 static void event_handler(void* arg, esp_event_base_t event_base, int32_t event_id, void* event_data)
 {
 	if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_START) {
@@ -134,6 +154,7 @@ esp_err_t wifi_init_sta(void)
 	return ret_value;
 }
 
+#if !CONFIG_CRON_EMBEDDED_CRONTAB
 static void printSPIFFS(char * path) {
 	DIR* dir = opendir(path);
 	assert(dir != NULL);
@@ -187,10 +208,13 @@ esp_err_t mountSPIFFS(char * partition_label, char * base_path) {
 	ESP_LOGI(TAG, "Mount SPIFFS filesystem");
 	return ret;
 }
+#endif
 
 void time_sync_notification_cb(struct timeval *tv)
 {
 	ESP_LOGI(TAG, "Notification of a time synchronization event");
+	// The system time has been stepped, so the scheduler must recalculate its sleep time
+	if (s_cron_task != NULL) xTaskNotifyGive(s_cron_task);
 }
 
 static void initialize_sntp(void)
@@ -219,210 +243,379 @@ static esp_err_t obtain_time(void)
 	return ESP_OK;
 }
 
+// Upper limit of one sleep of the scheduler
+#define CRON_MAX_SLEEP_MS (60*60*1000)
+
 typedef struct {
-	char dateTime[64];
+	cron_expr expr;
 	char taskName[32];
 	time_t next;
+	esp_err_t status; // Result of resolving the task name when the table is built
+	TX_COMMAND_t command; // Command for the channel, when status is ESP_OK
+#if CONFIG_CRON_KEEP_EXPRESSION
+	char dateTime[64];
+#endif
 } CRON_t;
 
+// The text of the cron expression is kept only for debugging
+#if CONFIG_CRON_KEEP_EXPRESSION
+#define CRON_EXPRESSION(cron) ((cron)->dateTime)
+#else
+#define CRON_EXPRESSION(cron) "-"
+#endif
+
+// Calculate the next "fire" date and time in UTC after the specified UTC.
+// The cron expression is evaluated in local wall time.
+static time_t next_fire(CRON_t *cron, time_t utc) {
+	time_t local = tzcache_to_local(utc);
+	while (1) {
+		local = cron_next(&cron->expr, local);
+		if (local == (time_t)-1) return local;
+		time_t next = tzcache_to_utc(local);
+		if (next > utc) return next;
+		// A repeated local time fires only at the first occurrence
+	}
+}
+
+// Resolve the channel once, so firing does not look up the channel by the name.
+// Channels such as usb3/on or usb3/on:3 are served by the RF transmitter.
+// task_on and task_off are for the channel 0.
+static void resolve_task(CRON_t *cron) {
+	char *path = cron->taskName;
+	if (strncmp(path, "task_on", 7) == 0 || strncmp(path, "task_off", 8) == 0) path = path + 5;
+	cron->status = channel_command(path, &cron->command);
+	if (cron->status == ESP_ERR_NOT_FOUND) {
+		// A task handle is not kept, because the task may be deleted
+		ESP_LOGI(TAG, "%s is not a channel, it notifies the task", cron->taskName);
+	} else if (cron->status == ESP_ERR_INVALID_STATE) {
+		ESP_LOGE(TAG, "%s has not been taught", cron->taskName);
+	} else if (cron->status == ESP_ERR_INVALID_ARG) {
+		ESP_LOGE(TAG, "%s has invalid repeats", cron->taskName);
+	}
+}
+
+
+#if CONFIG_CRON_EMBEDDED_CRONTAB
+// Entry of the crontab converted at build time
+typedef struct {
+	cron_expr expr;
+	char taskName[32];
+	char dateTime[64];
+} EMBEDDED_CRON_t;
 
-esp_err_t build_table(char *fileName, CRON_t **tables, int16_t *ntable) {
+#include "embedded_crontab.h"
+
+// Build the table from the crontab embedded in flash
+esp_err_t build_embedded_table(CRON_t **tables, int16_t *ntable) {
+	*tables = NULL;
+	*ntable = 0;
+	if (EMBEDDED_CRONTAB_SIZE == 0) {
+		ESP_LOGW(__FUNCTION__, "embedded crontab has no entries");
+		return ESP_OK;
+	}
+	CRON_t *table = calloc(EMBEDDED_CRONTAB_SIZE, sizeof(CRON_t));
+	if (table == NULL) {
+		ESP_LOGE(__FUNCTION__, "Error allocating memory for table");
+		return ESP_ERR_NO_MEM;
+	}
+
+	time_t cur = time(NULL);
+	for (int index=0;index<EMBEDDED_CRONTAB_SIZE;index++) {
+		// The cron expression has been parsed at build time
+		CRON_t *cron = table+index;
+		memcpy(&cron->expr, &embedded_crontab[index].expr, sizeof(cron_expr));
+		strcpy(cron->taskName, embedded_crontab[index].taskName);
+#if CONFIG_CRON_KEEP_EXPRESSION
+		strcpy(cron->dateTime, embedded_crontab[index].dateTime);
+#endif
+		cron->next = next_fire(cron, cur);
+		resolve_task(cron);
+		ESP_LOGD(__FUNCTION__, "dateTime[%d]=[%s]", index, embedded_crontab[index].dateTime);
+		ESP_LOGD(__FUNCTION__, "taskName[%d]=[%s]", index, cron->taskName);
+	}
+	ESP_LOGI(__FUNCTION__, "%d entries", EMBEDDED_CRONTAB_SIZE);
+	*tables = table;
+	*ntable = EMBEDDED_CRONTAB_SIZE;
+	return ESP_OK;
+}
+
+#else
+// Skip blanks
+static char *skip_blank(char *pos) {
+	while (*pos == ' ' || *pos == '\t') pos++;
+	return pos;
+}
+
+// Skip non-blank characters
+static char *skip_token(char *pos) {
+	while (*pos != '\0' && *pos != ' ' && *pos != '\t') pos++;
+	return pos;
+}
+
+esp_err_t build_table(char *fileName, CRON_t **tables, int16_t *ntable, struct stat *st) {
+	*tables = NULL;
+	*ntable = 0;
+
+	// Read the whole file with a single read
+	if (stat(fileName, st) != 0) {
+		ESP_LOGE(__FUNCTION__, "Failed to stat %s", fileName);
+		return ESP_FAIL;
+	}
+	char *text = malloc(st->st_size + 1);
+	if (text == NULL) {
+		ESP_LOGE(__FUNCTION__, "Error allocating memory for %s", fileName);
+		return ESP_ERR_NO_MEM;
+	}
 	FILE* f = fopen(fileName, "r");
 	if (f == NULL) {
 		ESP_LOGE(__FUNCTION__, "Failed to open file for reading");
+		free(text);
 		return ESP_FAIL;
 	}
-	char line[128];
-	int _ntable = 0;
-	while (1){
-		if ( fgets(line, sizeof(line) ,f) == 0 ) break;
-		// strip newline
-		ESP_LOGD(__FUNCTION__, "line0=[%s]", line);
-		char* pos = strchr(line, '\n');
-		if (pos) *pos = '\0';
-		if (strlen(line) == 0) continue;
-		if (line[0] == '#') continue;
-		ESP_LOGD(__FUNCTION__, "line1=[%s]", line);
-		_ntable++;
-	}
+	size_t length = fread(text, 1, st->st_size, f);
 	fclose(f);
-	ESP_LOGI(__FUNCTION__, "_ntable=%d", _ntable);
+	text[length] = '\0';
+	ESP_LOGI(__FUNCTION__, "%s %d bytes", fileName, length);
 
-	*tables = calloc(_ntable, sizeof(CRON_t));
-	if (*tables == NULL) {
-		ESP_LOGE(__FUNCTION__, "Error allocating memory for topic");
-		return ESP_ERR_NO_MEM;
-	}
+	time_t cur = time(NULL);
 
-	char dateTime[64];
-	char taskName[128];
-	int index = 0;
-	f = fopen(fileName, "r");
-	while (1){
-		if ( fgets(line, sizeof(line) ,f) == 0 ) break;
-		// strip newline
-		ESP_LOGD(__FUNCTION__, "line0=[%s]", line);
-		char* pos = strchr(line, '\n');
-		if (pos) *pos = '\0';
-		if (strlen(line) == 0) continue;
-		if (line[0] == '#') continue;
-		ESP_LOGD(__FUNCTION__, "line1=[%s]", line);
+	CRON_t *table = NULL;
+	int16_t capacity = 0;
+	int16_t index = 0;
+	int lineNumber = 0;
+	char *next = text;
+	while (*next != '\0') {
+		// Cut out one line
+		char *line = next;
+		char *eol = strchr(line, '\n');
+		if (eol) {
+			*eol = '\0';
+			next = eol + 1;
+		} else {
+			next = line + strlen(line);
+		}
+		lineNumber++;
+		char *cr = strchr(line, '\r');
+		if (cr) *cr = '\0';
+		ESP_LOGD(__FUNCTION__, "line%d=[%s]", lineNumber, line);
+
+		line = skip_blank(line);
+		if (*line == '\0') continue;
+		if (*line == '#') continue;
+
+		// Split the six fields of cron expression and the task name in place
+		char *pos = line;
 		int items = 0;
-		for(int pos=0;pos<strlen(line);pos++) {
-			int c1 = line[pos];
-			ESP_LOGD(__FUNCTION__, "c1[%d]=0x%x items=%d", pos, c1, items);
-			if (c1 == 0x20) items++;
-			if (items == 6) {
-				strcpy(taskName, &line[pos+1]);
-				break;
-			}
-			dateTime[pos] = c1;
-			dateTime[pos+1] = 0;
+		while (items < 6) {
+			pos = skip_blank(pos);
+			if (*pos == '\0') break;
+			pos = skip_token(pos);
+			items++;
+			// The cron expression parser separates fields only by space
+			if (*pos == '\t') *pos = ' ';
+		}
+		if (items < 6) {
+			ESP_LOGE(__FUNCTION__, "line %d: cron expression must consist of 6 fields [%s]", lineNumber, line);
+			continue;
+		}
+		char *dateTime_end = pos;
+		char *taskName = skip_blank(pos);
+		pos = skip_token(taskName);
+		*pos = '\0';
+		*dateTime_end = '\0';
+		if (*taskName == '\0') {
+			ESP_LOGE(__FUNCTION__, "line %d: task name not found [%s]", lineNumber, line);
+			continue;
 		}
+		if (strlen(taskName) >= sizeof(table->taskName)) {
+			ESP_LOGE(__FUNCTION__, "line %d: task name too long [%s]", lineNumber, taskName);
+			continue;
+		}
+#if CONFIG_CRON_KEEP_EXPRESSION
+		if (strlen(line) >= sizeof(table->dateTime)) {
+			ESP_LOGE(__FUNCTION__, "line %d: cron expression too long [%s]", lineNumber, line);
+			continue;
+		}
+#endif
+		ESP_LOGD(__FUNCTION__, "dateTime=[%s]", line);
+		ESP_LOGD(__FUNCTION__, "taskName=[%s]", taskName);
 
-		// Remove comment from taskName
-		for (int pos=0;pos<strlen(taskName);pos++) {
-			int c1 = taskName[pos];
-			if (c1 == 0x20) taskName[pos] = 0;
+		// Grow the table geometrically
+		if (index == capacity) {
+			if (capacity == INT16_MAX) {
+				ESP_LOGE(__FUNCTION__, "line %d: too many entries", lineNumber);
+				break;
+			}
+			int16_t _capacity = (capacity == 0) ? 16 : (capacity > INT16_MAX / 2) ? INT16_MAX : capacity * 2;
+			CRON_t *_table = realloc(table, _capacity * sizeof(CRON_t));
+			if (_table == NULL) {
+				ESP_LOGE(__FUNCTION__, "Error allocating memory for table");
+				free(table);
+				free(text);
+				return ESP_ERR_NO_MEM;
+			}
+			table = _table;
+			capacity = _capacity;
 		}
 
-		ESP_LOGI(__FUNCTION__, "dateTime=[%s]", dateTime);
-		ESP_LOGI(__FUNCTION__, "taskName=[%s]", taskName);
-		cron_expr expr;
+		// Parse the cron expression only once and keep the result
 		const char* err = NULL;
-		memset(&expr, 0, sizeof(expr));
-		cron_parse_expr(dateTime, &expr, &err);
+		CRON_t *cron = table+index;
+		memset(cron, 0, sizeof(CRON_t));
+		cron_parse_expr(line, &cron->expr, &err);
 		if (err) {
-			ESP_LOGE(__FUNCTION__, "[%s] %s", line, err);
-		} else {
-			strcpy((*tables+index)->dateTime, dateTime);
-			strcpy((*tables+index)->taskName, taskName);
-			time_t cur = time(NULL);
-			cur = cur + (CONFIG_LOCAL_TIMEZONE*60*60);
-			(*tables+index)->next = cron_next(&expr, cur);
-			index++;
+			ESP_LOGE(__FUNCTION__, "line %d: %s [%s]", lineNumber, err, line);
+			continue;
 		}
+#if CONFIG_CRON_KEEP_EXPRESSION
+		strcpy(cron->dateTime, line);
+#endif
+		strcpy(cron->taskName, taskName);
+		cron->next = next_fire(cron, cur);
+		resolve_task(cron);
+		index++;
+	}
+	free(text);
+
+	// Release the unused part of the table
+	if (index > 0 && index < capacity) {
+		CRON_t *_table = realloc(table, index * sizeof(CRON_t));
+		if (_table != NULL) table = _table;
 	}
 	for (int i=0;i<index;i++) {
-		ESP_LOGI(__FUNCTION__, "dateTime[%d]=[%s]", i, (*tables+i)->dateTime);
-		ESP_LOGI(__FUNCTION__, "taskName[%d]=[%s]", i, (*tables+i)->taskName);
+		ESP_LOGD(__FUNCTION__, "dateTime[%d]=[%s]", i, CRON_EXPRESSION(table+i));
+		ESP_LOGD(__FUNCTION__, "taskName[%d]=[%s]", i, (table+i)->taskName);
 	}
+	ESP_LOGI(__FUNCTION__, "%d lines %d entries", lineNumber, index);
+	*tables = table;
 	*ntable = index;
 	return ESP_OK;
 }
+#endif
 
-// Turn on USB
-void task_on(void *pvParameters) {
-	ESP_LOGI(pcTaskGetName(NULL), "%"PRIu32" Start", (uint32_t)xTaskGetCurrentTaskHandle());
-
-	// Open NVS
-	nvs_handle_t my_handle;
-	esp_err_t err = nvs_open("storage", NVS_READWRITE, &my_handle);
-	if (err != ESP_OK) {
-		ESP_LOGE(pcTaskGetName(NULL), "nvs_open error (%s)", esp_err_to_name(err));
-		vTaskDelete(NULL);
+#if CRON_RELOAD
+// FNV-1a hash of the parsed cron expression and the task name
+static uint32_t hash_entry(CRON_t *cron) {
+	uint32_t hash = 2166136261u;
+	uint8_t *bytes = (uint8_t *)&cron->expr;
+	for (int i=0;i<sizeof(cron_expr);i++) {
+		hash = (hash ^ bytes[i]) * 16777619u;
 	}
-
-	// Read NVS
-	uint32_t ValueOn = 0;
-	uint16_t BitlengthOn = 0;
-	uint16_t ProtocolOn = 0;
-
-	err = nvs_get_u32(my_handle, "ValueOn", &ValueOn);
-	if (err != ESP_OK) {
-		ESP_LOGE(pcTaskGetName(NULL), "ValueOn get failed");
-		vTaskDelete(NULL);
+	for (char *c=cron->taskName;*c!='\0';c++) {
+		hash = (hash ^ (uint8_t)*c) * 16777619u;
 	}
-	ESP_LOGI(pcTaskGetName(NULL), "ValueOn=%lu", ValueOn);
+	return hash;
+}
 
-	err = nvs_get_u16(my_handle, "BitlengthOn", &BitlengthOn);
-	if (err != ESP_OK) {
-		ESP_LOGE(pcTaskGetName(NULL), "BitlengthOn get failed");
-		vTaskDelete(NULL);
+// Rebuild the table when the crontab has been changed, or always when forced.
+// Entries that are not changed keep their next "fire" date and time.
+static bool reload_table(char *fileName, struct stat *loaded, CRON_t **tables, int16_t *ntable, bool force) {
+	struct stat st;
+	if (stat(fileName, &st) != 0) return false;
+	if (!force && st.st_mtime == loaded->st_mtime && st.st_size == loaded->st_size) return false;
+	ESP_LOGI(__FUNCTION__, "%s has been changed", fileName);
+
+	CRON_t *_tables;
+	int16_t _ntable;
+	if (build_table(fileName, &_tables, &_ntable, &st) != ESP_OK) {
+		ESP_LOGE(__FUNCTION__, "Keep the current table");
+		return false;
 	}
-	ESP_LOGI(pcTaskGetName(NULL), "BitlengthOn=%u", BitlengthOn);
 
-	err = nvs_get_u16(my_handle, "ProtocolOn", &ProtocolOn);
-	if (err != ESP_OK) {
-		ESP_LOGE(pcTaskGetName(NULL), "ProtocolOn get failed");
-		vTaskDelete(NULL);
+	uint32_t *hashes = calloc(*ntable > 0 ? *ntable : 1, sizeof(uint32_t));
+	if (hashes == NULL) {
+		ESP_LOGE(__FUNCTION__, "Error allocating memory for hash");
+		free(_tables);
+		return false;
 	}
-	ESP_LOGI(pcTaskGetName(NULL), "ProtocolOn=%u", ProtocolOn);
-
-	// Close NVS
-	nvs_close(my_handle);
-
-	// Initialize RF
-	RCSWITCH_t RCSwitch;
-	initSwich(&RCSwitch);
-	enableTransmit(&RCSwitch, CONFIG_RF_GPIO);
-	setRepeatTransmit(&RCSwitch, 10);
-
-	while(1) {
-		ulTaskNotifyTake( pdTRUE, portMAX_DELAY );
-		ESP_LOGI(pcTaskGetName(NULL), "Wake Up");
-		setProtocol(&RCSwitch, ProtocolOn);
-		sendCode(&RCSwitch, ValueOn, BitlengthOn);
-		ESP_LOGD(pcTaskGetName(NULL), "Wait for Notify");
+	for (int i=0;i<*ntable;i++) {
+		hashes[i] = hash_entry(*tables+i);
+	}
+	int kept = 0;
+	for (int j=0;j<_ntable;j++) {
+		CRON_t *cron = _tables+j;
+		uint32_t hash = hash_entry(cron);
+		for (int i=0;i<*ntable;i++) {
+			CRON_t *old = *tables+i;
+			if (hashes[i] != hash) continue;
+			if (old->taskName[0] == '\0') continue; // Already taken over
+			if (memcmp(&old->expr, &cron->expr, sizeof(cron_expr)) != 0) continue;
+			if (strcmp(old->taskName, cron->taskName) != 0) continue;
+			cron->next = old->next;
+			old->taskName[0] = '\0';
+			kept++;
+			break;
+		}
 	}
-	vTaskDelete(NULL);
+	free(hashes);
+	ESP_LOGI(__FUNCTION__, "%d entries, %d unchanged", _ntable, kept);
+
+	// Swap the table
+	free(*tables);
+	*tables = _tables;
+	*ntable = _ntable;
+	*loaded = st;
+	return true;
 }
 
-// Turn off USB
-void task_off(void *pvParameters) {
-	ESP_LOGI(pcTaskGetName(NULL), "%"PRIu32" Start", (uint32_t)xTaskGetCurrentTaskHandle());
+#if CONFIG_CRON_UPLOAD
+// Called from the HTTP server task when a new crontab has been written
+static void request_reload(void) {
+	__atomic_store_n(&s_reload_requested, true, __ATOMIC_SEQ_CST);
+	if (s_cron_task != NULL) xTaskNotifyGive(s_cron_task);
+}
+#endif
+#endif
 
-	// Open NVS
-	nvs_handle_t my_handle;
-	esp_err_t err = nvs_open("storage", NVS_READWRITE, &my_handle);
-	if (err != ESP_OK) {
-		ESP_LOGE(pcTaskGetName(NULL), "nvs_open error (%s)", esp_err_to_name(err));
-		vTaskDelete(NULL);
+// Min-heap of crontab entries ordered by the next "fire" date and time
+static void heap_down(CRON_t **heap, int16_t nheap, int16_t index) {
+	while (1) {
+		int16_t smallest = index;
+		int16_t left = index * 2 + 1;
+		int16_t right = index * 2 + 2;
+		if (left < nheap && heap[left]->next < heap[smallest]->next) smallest = left;
+		if (right < nheap && heap[right]->next < heap[smallest]->next) smallest = right;
+		if (smallest == index) break;
+		CRON_t *temp = heap[index];
+		heap[index] = heap[smallest];
+		heap[smallest] = temp;
+		index = smallest;
 	}
+}
 
-	// Read NVS
-	uint32_t ValueOff = 0;
-	uint16_t BitlengthOff = 0;
-	uint16_t ProtocolOff = 0;
-
-	err = nvs_get_u32(my_handle, "ValueOff", &ValueOff);
-	if (err != ESP_OK) {
-		ESP_LOGE(pcTaskGetName(NULL), "ValueOff get failed");
-		vTaskDelete(NULL);
+static int16_t build_heap(CRON_t *tables, int16_t ntable, CRON_t **heap) {
+	int16_t nheap = 0;
+	for (int index=0;index<ntable;index++) {
+		if ((tables+index)->next == (time_t)-1) continue;
+		heap[nheap++] = tables+index;
 	}
-	ESP_LOGI(pcTaskGetName(NULL), "ValueOff=%lu", ValueOff);
-
-	err = nvs_get_u16(my_handle, "BitlengthOff", &BitlengthOff);
-	if (err != ESP_OK) {
-		ESP_LOGE(pcTaskGetName(NULL), "BitlengthOff get failed");
-		vTaskDelete(NULL);
+	for (int index=nheap/2-1;index>=0;index--) {
+		heap_down(heap, nheap, index);
 	}
-	ESP_LOGI(pcTaskGetName(NULL), "BitlengthOff=%u", BitlengthOff);
+	return nheap;
+}
 
-	err = nvs_get_u16(my_handle, "ProtocolOff", &ProtocolOff);
-	if (err != ESP_OK) {
-		ESP_LOGE(pcTaskGetName(NULL), "ProtocolOff get failed");
-		vTaskDelete(NULL);
+// Notify the task specified in the crontab entry
+static void fire_task(CRON_t *cron) {
+	if (cron->status == ESP_OK) {
+		ESP_LOGI(TAG, "Send %s [%s]", cron->taskName, CRON_EXPRESSION(cron));
+		// Do not wait here, the scheduler must not be delayed by the transmitter
+		transmitter_send(&cron->command, 0);
+		return;
+	}
+	if (cron->status != ESP_ERR_NOT_FOUND) {
+		ESP_LOGE(TAG, "%s is not sent (%s)", cron->taskName, esp_err_to_name(cron->status));
+		return;
 	}
-	ESP_LOGI(pcTaskGetName(NULL), "ProtocolOff=%u", ProtocolOff);
-
-	// Close NVS
-	nvs_close(my_handle);
-
-	// Initialize RF
-	RCSWITCH_t RCSwitch;
-	initSwich(&RCSwitch);
-	enableTransmit(&RCSwitch, CONFIG_RF_GPIO);
-	setRepeatTransmit(&RCSwitch, 10);
 
-	while(1) {
-		ulTaskNotifyTake( pdTRUE, portMAX_DELAY );
-		ESP_LOGI(pcTaskGetName(NULL), "Wake Up");
-		setProtocol(&RCSwitch, ProtocolOff);
-		sendCode(&RCSwitch, ValueOff, BitlengthOff);
-		ESP_LOGD(pcTaskGetName(NULL), "Wait for Notify");
+	// Look up the task every time, it may have been started or deleted since the table was built
+	TaskHandle_t taskHandle = xTaskGetHandle(cron->taskName);
+	if (taskHandle != NULL) {
+		ESP_LOGI(TAG, "NotifGive to %s [%s]", cron->taskName, CRON_EXPRESSION(cron));
+		xTaskNotifyGive(taskHandle);
+	} else {
+		ESP_LOGE(TAG, "%s not active", cron->taskName);
 	}
-	vTaskDelete(NULL);
 }
 
 void app_main(void)
@@ -441,93 +634,155 @@ void app_main(void)
 	// Obtain time over NTP
 	ESP_ERROR_CHECK(obtain_time());
 
+	// Set local timezone
+	// An old sdkconfig has only the whole-hour offset, that is UTC-9 for +9 in POSIX TZ
+	char tz[16];
+	if (strlen(CONFIG_LOCAL_TZ) == 0) {
+		snprintf(tz, sizeof(tz), "UTC%d", -CONFIG_LOCAL_TIMEZONE);
+		if (CONFIG_LOCAL_TIMEZONE != 0) {
+			ESP_LOGW(TAG, "LOCAL_TIMEZONE is deprecated. Set LOCAL_TZ to %s", tz);
+		}
+		tzcache_init(tz);
+	} else {
+		if (CONFIG_LOCAL_TIMEZONE != 0) {
+			ESP_LOGW(TAG, "LOCAL_TIMEZONE is ignored. LOCAL_TZ is used");
+		}
+		tzcache_init(CONFIG_LOCAL_TZ);
+	}
+
 #if 0
 	// Print current time
 	char buffer[32];
 	time_t cur = time(NULL);
-	cur = cur + (CONFIG_LOCAL_TIMEZONE*60*60);
 	struct tm *cur_timeinfo;
-	cur_timeinfo = gmtime(&cur);
+	cur_timeinfo = localtime(&cur);
 	strftime(buffer, sizeof(buffer), "%Y/%m/%d %H:%M:%S", cur_timeinfo);
 	ESP_LOGI(TAG, "buffer=[%s]", buffer);
 #endif
 
+	// Start RF transmitter.
+	// The channels are loaded first, so the crontab entries are resolved into commands.
+	ESP_ERROR_CHECK(channel_init());
+	ESP_ERROR_CHECK(transmitter_start(CONFIG_RF_GPIO));
+
+	// Read crontab
+	CRON_t *crontab;
+	int16_t	lcrontab;
+#if CONFIG_CRON_EMBEDDED_CRONTAB
+	// The crontab has been converted at build time, so SPIFFS is not used
+	ret = build_embedded_table(&crontab, &lcrontab);
+#else
 	// Mount SPIFFS
 	char *partition_label = "storage";
 	char *base_path = "/spiffs"; 
 	ESP_ERROR_CHECK(mountSPIFFS(partition_label, base_path));
 	printSPIFFS(base_path);
-	
-	// Read crontab
-	CRON_t *crontab;
-	int16_t	lcrontab;
+
+	struct stat crontab_stat;
 	char fileName[128];
 	sprintf(fileName, "%s/crontab", base_path);
-	ret = build_table(fileName, &crontab, &lcrontab);
+	ret = build_table(fileName, &crontab, &lcrontab, &crontab_stat);
+#endif
 
-	// Start task
-	xTaskCreate(task_on, "task_on", 1024*4, NULL, 2, NULL);
-	xTaskCreate(task_off, "task_off", 1024*4, NULL, 2, NULL);
+	// Build the schedule
+	CRON_t **heap = calloc(lcrontab > 0 ? lcrontab : 1, sizeof(CRON_t *));
+	if (heap == NULL) {
+		ESP_LOGE(TAG, "Error allocating memory for schedule");
+		vTaskDelete(NULL);
+	}
+	int16_t nheap = build_heap(crontab, lcrontab, heap);
+	ESP_LOGI(TAG, "nheap=%d", nheap);
+	s_cron_task = xTaskGetCurrentTaskHandle();
+#if CONFIG_CRON_RELOAD_INTERVAL
+	TickType_t reload_interval = pdMS_TO_TICKS(CONFIG_CRON_RELOAD_INTERVAL * 1000);
+	TickType_t reload_tick = xTaskGetTickCount();
+#endif
+#if CONFIG_CRON_UPLOAD
+	// The upload notifies this task, so the scheduler does not poll the file
+	ESP_ERROR_CHECK(upload_start(fileName, request_reload));
+#endif
 
 	// Start main loop
-	cron_expr expr;
-	const char* err = NULL;
 	while (1) {
+#if CRON_RELOAD
+		// Reload the crontab when it has been uploaded or changed
+		// An uploaded crontab is always reloaded, even if its mtime is unchanged
+		// Read and clear the flag in one step, so an upload finishing in between is not lost
+		bool uploaded = __atomic_exchange_n(&s_reload_requested, false, __ATOMIC_SEQ_CST);
+		bool reload = uploaded;
+#if CONFIG_CRON_RELOAD_INTERVAL
+		if (xTaskGetTickCount() - reload_tick >= reload_interval) {
+			reload_tick = xTaskGetTickCount();
+			reload = true;
+		}
+#endif
+		if (reload) {
+			if (reload_table(fileName, &crontab_stat, &crontab, &lcrontab, uploaded)) {
+				free(heap);
+				heap = calloc(lcrontab > 0 ? lcrontab : 1, sizeof(CRON_t *));
+				if (heap == NULL) {
+					ESP_LOGE(TAG, "Error allocating memory for schedule");
+					vTaskDelete(NULL);
+				}
+				nheap = build_heap(crontab, lcrontab, heap);
+				ESP_LOGI(TAG, "nheap=%d", nheap);
+			}
+		}
+#endif
+
 		// Get current date and time
 		time_t cur = time(NULL);
-		cur = cur + (CONFIG_LOCAL_TIMEZONE*60*60);
-
-		// Format current date and time
-		struct tm *cur_timeinfo;
-		cur_timeinfo = gmtime(&cur);
-		char cur_buffer[32];
-		strftime(cur_buffer, sizeof(cur_buffer), "%Y/%m/%d %H:%M:%S", cur_timeinfo);
-		ESP_LOGD(TAG, "current time=[%s]", cur_buffer);
-
-		for (int index=0;index<lcrontab;index++) {
-			ESP_LOGD(TAG, "dateTime[%d]=[%s]", index, (crontab+index)->dateTime);
-			ESP_LOGD(TAG, "taskName[%d]=[%s]", index, (crontab+index)->taskName);
-
-			// Format the next "fire" date and time
-			time_t next = (crontab+index)->next;
-			struct tm *next_timeinfo;
-			next_timeinfo = gmtime(&next);
-			char next_buffer[32];
-			strftime(next_buffer, sizeof(next_buffer), "%Y/%m/%d %H:%M:%S", next_timeinfo);
-			ESP_LOGD(TAG, "next=[%s]", next_buffer);
-
-			// Compare the current date and time with the next "fire" date and time
-			if (strcmp(cur_buffer, next_buffer) == 0) {
-
-				// Get the task handle to notify
-				TaskHandle_t taskHandle = xTaskGetHandle((crontab+index)->taskName);
-				ESP_LOGI(TAG, "taskname=[%s] taskHandle=%"PRIu32, (crontab+index)->taskName, (uint32_t)taskHandle);
-				if (taskHandle != NULL) {
-#if 0
-					eTaskState taskState = eTaskGetState(taskHandle);
-					ESP_LOGI(TAG, "taskState=%d", taskState);
-					if (taskState == eReady) ESP_LOGI(TAG, "taskState=eReady");
-					if (taskState == eRunning) ESP_LOGI(TAG, "taskState=eRunning");
-					if (taskState == eBlocked) ESP_LOGI(TAG, "taskState=eBlocked");
-					if (taskState == eSuspended) ESP_LOGI(TAG, "taskState=eSuspended");
-					if (taskState == eDeleted) ESP_LOGI(TAG, "taskState=eDeleted");
-#endif
-					ESP_LOGI(TAG, "current time=[%s]", cur_buffer);
-					ESP_LOGI(TAG, "NotifGive to %s [%s]", (crontab+index)->taskName, (crontab+index)->dateTime);
-					xTaskNotifyGive(taskHandle);
-
-					// Parses specified cron expression
-					memset(&expr, 0, sizeof(expr));
-					cron_parse_expr((crontab+index)->dateTime, &expr, &err);
-
-					// Set the specified expression to calculate the next 'fire' date after the specified date
-					(crontab+index)->next = cron_next(&expr, cur);
-				} else {
-					ESP_LOGE(TAG, "%s not active", (crontab+index)->taskName);
+
+		// Fire all entries whose "fire" date and time has come
+		while (nheap > 0 && heap[0]->next <= cur) {
+			CRON_t *cron = heap[0];
+
+			if (cron->next < cur) {
+				// The "fire" date and time has passed while we were busy
+				ESP_LOGW(TAG, "[%s] %s is %"PRIi64" seconds overdue", CRON_EXPRESSION(cron), cron->taskName, (int64_t)(cur - cron->next));
+#if CONFIG_CRON_MISFIRE_SKIP
+				ESP_LOGW(TAG, "[%s] %s skipped", CRON_EXPRESSION(cron), cron->taskName);
+#elif CONFIG_CRON_MISFIRE_FIRE_ALL
+				int fired = 0;
+				while (cron->next != (time_t)-1 && cron->next <= cur && fired < CONFIG_CRON_MISFIRE_MAX) {
+					fire_task(cron);
+					cron->next = next_fire(cron, cron->next);
+					fired++;
 				}
+#else
+				fire_task(cron);
+#endif
+			} else {
+				fire_task(cron);
+			}
+
+			// Set the specified expression to calculate the next 'fire' date after the specified date
+			cron->next = next_fire(cron, cur);
+			if (cron->next == (time_t)-1) {
+				ESP_LOGW(TAG, "[%s] will not fire again", CRON_EXPRESSION(cron));
+				heap[0] = heap[--nheap];
 			}
+			heap_down(heap, nheap, 0);
+		}
+
+		// Sleep until the earliest "fire" date and time.
+		// The sleep is cut short when the system time is synchronized.
+		TickType_t ticks = portMAX_DELAY;
+		if (nheap > 0) {
+			struct timeval tv;
+			gettimeofday(&tv, NULL);
+			int64_t wait_ms = ((int64_t)heap[0]->next - tv.tv_sec) * 1000 - tv.tv_usec / 1000;
+			if (wait_ms < 0) wait_ms = 0;
+			if (wait_ms > CRON_MAX_SLEEP_MS) wait_ms = CRON_MAX_SLEEP_MS;
+			ticks = (wait_ms / portTICK_PERIOD_MS) + 1;
+			ESP_LOGD(TAG, "sleep %"PRIi64" ms until [%s]", wait_ms, CRON_EXPRESSION(heap[0]));
 		}
-		// delay 1 second
-		vTaskDelay(100);
+#if CONFIG_CRON_RELOAD_INTERVAL
+		// Wake up to check the crontab
+		TickType_t elapsed = xTaskGetTickCount() - reload_tick;
+		TickType_t reload_ticks = (elapsed < reload_interval) ? reload_interval - elapsed : 0;
+		if (reload_ticks < ticks) ticks = reload_ticks;
+#endif
+		ulTaskNotifyTake(pdTRUE, ticks);
 	} // end while
 }
@@ -0,0 +1,124 @@
+/*
+	Precomputed offset transitions of the local timezone
+
+	This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+	Unless required by applicable law or agreed to in writing, this
+	software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+	CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <time.h>
+#include "esp_log.h"
+
+#include "tzcache.h"
+
+// Range of the precomputed transitions
+#define TZCACHE_BEFORE (7*24*60*60)
+#define TZCACHE_AFTER (4*366*24*60*60)
+
+// Interval to probe the offset. Offsets never change twice within a week.
+#define TZCACHE_PROBE (7*24*60*60)
+
+#define TZCACHE_MAX_TRANSITIONS 16
+
+typedef struct {
+	time_t at; // UTC of the transition
+	int32_t offset; // Offset from UTC after the transition
+} TRANSITION_t;
+
+static time_t s_start = 0;
+static time_t s_end = -1;
+static int32_t s_offset; // Offset from UTC before the first transition
+static TRANSITION_t s_transitions[TZCACHE_MAX_TRANSITIONS];
+static int s_ntransition = 0;
+
+// Offset of the local time from UTC in seconds
+static int32_t offset_at(time_t utc) {
+	struct tm lt, gt;
+	localtime_r(&utc, &lt);
+	gmtime_r(&utc, &gt);
+	int32_t days = lt.tm_yday - gt.tm_yday;
+	if (lt.tm_year != gt.tm_year) days = (lt.tm_year > gt.tm_year) ? 1 : -1;
+	return ((days * 24 + lt.tm_hour - gt.tm_hour) * 60 + lt.tm_min - gt.tm_min) * 60 + lt.tm_sec - gt.tm_sec;
+}
+
+// Precompute the transitions from a week before to four years after the specified time
+static void build_cache(time_t utc) {
+	s_start = utc - TZCACHE_BEFORE;
+	s_end = utc + TZCACHE_AFTER;
+	s_offset = offset_at(s_start);
+	s_ntransition = 0;
+
+	int32_t offset = s_offset;
+	for (time_t probe=s_start;probe<s_end;) {
+		time_t next = probe + TZCACHE_PROBE;
+		if (next > s_end) next = s_end;
+		int32_t _offset = offset_at(next);
+		if (_offset != offset) {
+			// Find the first second of the new offset
+			time_t low = probe;
+			time_t high = next;
+			while (high - low > 1) {
+				time_t mid = low + (high - low) / 2;
+				if (offset_at(mid) == offset) {
+					low = mid;
+				} else {
+					high = mid;
+				}
+			}
+			if (s_ntransition == TZCACHE_MAX_TRANSITIONS) {
+				// Shorten the range instead
+				s_end = high;
+				break;
+			}
+			s_transitions[s_ntransition].at = high;
+			s_transitions[s_ntransition].offset = offset_at(high);
+			ESP_LOGD(__FUNCTION__, "transition at %"PRIi64" offset %"PRIi32, (int64_t)high, s_transitions[s_ntransition].offset);
+			offset = s_transitions[s_ntransition].offset;
+			s_ntransition++;
+			// Offsets may change again before the next probe
+			next = high;
+		}
+		probe = next;
+	}
+	ESP_LOGI(__FUNCTION__, "offset %"PRIi32" with %d transitions", s_offset, s_ntransition);
+}
+
+// Rebuild the cache when the time is out of range, for example after the time is set
+static void check_cache(time_t utc) {
+	if (utc < s_start + 24*60*60 || utc > s_end - 24*60*60) build_cache(utc);
+}
+
+void tzcache_init(const char *tz) {
+	ESP_LOGI(__FUNCTION__, "TZ=%s", tz);
+	setenv("TZ", tz, 1);
+	tzset();
+	build_cache(time(NULL));
+}
+
+time_t tzcache_to_local(time_t utc) {
+	check_cache(utc);
+	int32_t offset = s_offset;
+	for (int i=0;i<s_ntransition;i++) {
+		if (utc < s_transitions[i].at) break;
+		offset = s_transitions[i].offset;
+	}
+	return utc + offset;
+}
+
+time_t tzcache_to_utc(time_t local) {
+	check_cache(local);
+	// The first transition whose range contains the time gives the first occurrence
+	int32_t offset = s_offset;
+	for (int i=0;i<s_ntransition;i++) {
+		if (local - offset < s_transitions[i].at) break;
+		// The local time is skipped by the transition
+		if (local < s_transitions[i].at + s_transitions[i].offset) return s_transitions[i].at;
+		offset = s_transitions[i].offset;
+	}
+	return local - offset;
+}
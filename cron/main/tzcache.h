@@ -0,0 +1,17 @@
+#ifndef TZCACHE_H
+#define TZCACHE_H
+
+#include <time.h>
+
+// Set the POSIX TZ string and precompute the offset transitions around the current time
+void tzcache_init(const char *tz);
+
+// Convert UTC to local wall time counted as seconds from the epoch
+time_t tzcache_to_local(time_t utc);
+
+// Convert local wall time to UTC.
+// A skipped local time is converted to the transition.
+// A repeated local time is converted to the first occurrence.
+time_t tzcache_to_utc(time_t local);
+
+#endif /* TZCACHE_H */
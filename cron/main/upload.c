@@ -0,0 +1,131 @@
+/*
+	Replace the crontab over HTTP
+
+	This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+	Unless required by applicable law or agreed to in writing, this
+	software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+	CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include "esp_log.h"
+#include "esp_http_server.h"
+
+#include "upload.h"
+
+static const char *TAG = "UPLOAD";
+
+// Upper limit of the crontab size
+#define UPLOAD_MAX_SIZE (16*1024)
+
+// Number of the receive timeouts before giving up on a stalled client
+#define UPLOAD_TIMEOUT_RETRY 3
+
+static char s_fileName[64];
+static void (*s_uploaded)(void) = NULL;
+
+/* Handler for PUT /crontab */
+static esp_err_t crontab_put_handler(httpd_req_t *req)
+{
+	ESP_LOGI(TAG, "req->uri=[%s] req->content_len=%d", req->uri, req->content_len);
+	if (req->content_len > UPLOAD_MAX_SIZE) {
+		httpd_resp_set_status(req, "413 Payload Too Large");
+		httpd_resp_sendstr(req, "crontab too long\n");
+		return ESP_OK;
+	}
+
+	// Write a temporary file, so a broken upload does not destroy the current crontab
+	char tempName[sizeof(s_fileName) + 4];
+	snprintf(tempName, sizeof(tempName), "%s.new", s_fileName);
+	FILE *f = fopen(tempName, "w");
+	if (f == NULL) {
+		ESP_LOGE(TAG, "Failed to open %s", tempName);
+		httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Failed to open file");
+		return ESP_OK;
+	}
+	char buf[256];
+	int remaining = req->content_len;
+	int timeouts = 0;
+	while (remaining > 0) {
+		int received = httpd_req_recv(req, buf, remaining < sizeof(buf) ? remaining : sizeof(buf));
+		if (received == HTTPD_SOCK_ERR_TIMEOUT && ++timeouts < UPLOAD_TIMEOUT_RETRY) continue;
+		if (received <= 0) {
+			fclose(f);
+			unlink(tempName);
+			if (received == HTTPD_SOCK_ERR_TIMEOUT) {
+				httpd_resp_send_err(req, HTTPD_408_REQ_TIMEOUT, "Timeout receiving crontab");
+			}
+			// The connection is broken
+			return ESP_FAIL;
+		}
+		if (fwrite(buf, 1, received, f) != received) {
+			fclose(f);
+			unlink(tempName);
+			httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Failed to write file");
+			return ESP_OK;
+		}
+		remaining -= received;
+	}
+	fclose(f);
+
+	// SPIFFS does not rename onto an existing file
+	// Keep the current crontab as a backup until the new one is in place
+	char backupName[sizeof(s_fileName) + 4];
+	snprintf(backupName, sizeof(backupName), "%s.bak", s_fileName);
+	unlink(backupName);
+	bool backup = (rename(s_fileName, backupName) == 0);
+	if (rename(tempName, s_fileName) != 0) {
+		ESP_LOGE(TAG, "Failed to rename %s", tempName);
+		unlink(tempName);
+		if (backup && rename(backupName, s_fileName) != 0) {
+			ESP_LOGE(TAG, "Failed to restore %s", backupName);
+		}
+		httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Failed to rename file");
+		return ESP_OK;
+	}
+	// Only report success when the new crontab can be read back
+	f = fopen(s_fileName, "r");
+	if (f == NULL) {
+		ESP_LOGE(TAG, "Failed to open %s", s_fileName);
+		unlink(s_fileName);
+		if (backup && rename(backupName, s_fileName) != 0) {
+			ESP_LOGE(TAG, "Failed to restore %s", backupName);
+		}
+		httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Failed to read file");
+		return ESP_OK;
+	}
+	fclose(f);
+	if (backup) unlink(backupName);
+	ESP_LOGI(TAG, "%s %d bytes", s_fileName, req->content_len);
+	if (s_uploaded != NULL) s_uploaded();
+	httpd_resp_sendstr(req, "crontab updated\n");
+	return ESP_OK;
+}
+
+esp_err_t upload_start(const char *fileName, void (*uploaded)(void))
+{
+	strlcpy(s_fileName, fileName, sizeof(s_fileName));
+	s_uploaded = uploaded;
+
+	httpd_handle_t server = NULL;
+	httpd_config_t config = HTTPD_DEFAULT_CONFIG();
+	config.server_port = CONFIG_CRON_UPLOAD_PORT;
+	esp_err_t err = httpd_start(&server, &config);
+	if (err != ESP_OK) {
+		ESP_LOGE(TAG, "Failed to start HTTP server (%s)", esp_err_to_name(err));
+		return err;
+	}
+
+	httpd_uri_t crontab_uri = {
+		.uri		 = "/crontab",
+		.method		 = HTTP_PUT,
+		.handler	 = crontab_put_handler,
+	};
+	httpd_register_uri_handler(server, &crontab_uri);
+	ESP_LOGI(TAG, "PUT http://<address>:%d/crontab replaces %s", CONFIG_CRON_UPLOAD_PORT, s_fileName);
+	return ESP_OK;
+}
@@ -0,0 +1,10 @@
+#ifndef UPLOAD_H
+#define UPLOAD_H
+
+#include "esp_err.h"
+
+// Start the HTTP server which replaces the crontab.
+// uploaded is called after the new crontab has been written.
+esp_err_t upload_start(const char *fileName, void (*uploaded)(void));
+
+#endif /* UPLOAD_H */
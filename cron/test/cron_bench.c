@@ -0,0 +1,74 @@
+/*
+	Benchmark of cron_parse_expr and cron_next on the host
+
+	This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+	Unless required by applicable law or agreed to in writing, this
+	software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+	CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "ccronexpr.h"
+
+// Expressions from the crontab and the README, from cheap to expensive
+static const char *expressions[] = {
+	"0 0-59/10 * * * *",
+	"0 5-59/10 * * * *",
+	"*/15 * 1-4 * * *",
+	"0 0 7 ? * MON-FRI",
+	"0 0 12 1,15 * ?",
+	"0 30 23 30 1/3 ?",
+	"0 0 0 29 2 *",
+};
+
+static double now_ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+int main(int argc, char **argv) {
+	int iterations = (argc > 1) ? atoi(argv[1]) : 20000;
+	if (iterations <= 0) iterations = 1;
+
+	// Random start times from 2000 to 2040, the same for every expression
+	time_t *dates = malloc(iterations * sizeof(time_t));
+	if (dates == NULL) return 1;
+	srand(1);
+	for (int i=0;i<iterations;i++) {
+		dates[i] = 946684800 + (time_t)((double)rand() / RAND_MAX * 40 * 365.25 * 86400);
+	}
+
+	printf("%-22s %12s %12s\n", "expression", "parse ns", "next ns");
+	for (size_t e=0;e<sizeof(expressions)/sizeof(expressions[0]);e++) {
+		cron_expr expr;
+		const char *error = NULL;
+
+		double start = now_ns();
+		for (int i=0;i<iterations;i++) {
+			cron_parse_expr(expressions[e], &expr, &error);
+		}
+		double parse_ns = (now_ns() - start) / iterations;
+		if (error != NULL) {
+			printf("%-22s %s\n", expressions[e], error);
+			continue;
+		}
+
+		// Sum the results, so the calls are not optimized out
+		time_t sum = 0;
+		start = now_ns();
+		for (int i=0;i<iterations;i++) {
+			sum += cron_next(&expr, dates[i]);
+		}
+		double next_ns = (now_ns() - start) / iterations;
+		printf("%-22s %12.0f %12.0f\n", expressions[e], parse_ns, next_ns);
+		if (sum == 0) printf("\n");
+	}
+	free(dates);
+	return 0;
+}
@@ -0,0 +1,79 @@
+/*
+	Fuzz entry point for cron_parse_expr, cron_next and cron_prev
+
+	This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+	Unless required by applicable law or agreed to in writing, this
+	software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+	CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#include "ccronexpr.h"
+
+// A crontab line is read into a buffer of this size
+#define FUZZ_MAX_LEN 256
+
+// Start dates from 2000 to 2040
+static const time_t dates[] = {
+	946684800,	// 2000-01-01_00:00:00
+	951782399,	// 2000-02-28_23:59:59
+	1330473600,	// 2012-02-29_00:00:00
+	1356998399,	// 2012-12-31_23:59:59
+	1700000000,
+	2208988799,	// 2039-12-31_23:59:59
+};
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+	if (size >= FUZZ_MAX_LEN) return 0;
+	char expression[FUZZ_MAX_LEN];
+	memcpy(expression, data, size);
+	expression[size] = '\0';
+
+	cron_expr expr;
+	const char *error = NULL;
+	cron_parse_expr(expression, &expr, &error);
+	if (error != NULL) return 0;
+
+	for (size_t i=0;i<sizeof(dates)/sizeof(dates[0]);i++) {
+		// The next fire date is after the start date, the previous one before it
+		time_t next = cron_next(&expr, dates[i]);
+		if (next != (time_t)-1 && next <= dates[i]) abort();
+		time_t prev = cron_prev(&expr, dates[i]);
+		if (prev != (time_t)-1 && prev >= dates[i]) abort();
+		// A fire date is the previous fire date of the second after it
+		if (next != (time_t)-1 && cron_prev(&expr, next + 1) != next) abort();
+	}
+	return 0;
+}
+
+#ifndef CRON_LIBFUZZER
+// Without libFuzzer, run each file given as argument, or stdin (AFL)
+static void run_file(FILE *f) {
+	uint8_t data[FUZZ_MAX_LEN];
+	size_t size = fread(data, 1, sizeof(data), f);
+	LLVMFuzzerTestOneInput(data, size);
+}
+
+int main(int argc, char **argv) {
+	if (argc < 2) {
+		run_file(stdin);
+		return 0;
+	}
+	for (int i=1;i<argc;i++) {
+		FILE *f = fopen(argv[i], "rb");
+		if (f == NULL) {
+			perror(argv[i]);
+			return 1;
+		}
+		run_file(f);
+		fclose(f);
+	}
+	return 0;
+}
+#endif
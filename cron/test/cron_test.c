@@ -0,0 +1,148 @@
+/*
+	Table-driven test of cron_next and cron_prev on the host
+
+	This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+	Unless required by applicable law or agreed to in writing, this
+	software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+	CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#define _DEFAULT_SOURCE
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "ccronexpr.h"
+
+typedef struct {
+	const char *expression;
+	const char *date;
+	const char *expected;
+} CRON_CASE_t;
+
+// The expected dates were checked with a second-by-second scan.
+// All dates are UTC.
+static const CRON_CASE_t next_cases[] = {
+	{"0 0 0 31 * *", "2012-04-15_00:00:00", "2012-05-31_00:00:00"},
+	{"0 0 0 31 * *", "2012-01-31_00:00:00", "2012-03-31_00:00:00"},
+	{"0 0 0 30 * *", "2013-01-30_00:00:00", "2013-03-30_00:00:00"},
+	{"0 0 0 30 * *", "2012-01-30_12:00:00", "2012-03-30_00:00:00"},
+	{"0 0 0 29 2 *", "2012-03-01_00:00:00", "2016-02-29_00:00:00"},
+	{"0 0 0 29 2 *", "2015-01-01_00:00:00", "2016-02-29_00:00:00"},
+	// 2100 is not a leap year, so the next Feb 29 is beyond CRON_MAX_YEARS_DIFF
+	{"0 0 0 29 2 *", "2096-03-01_00:00:00", "invalid"},
+	{"0 0 0 1 1 *", "2012-12-31_23:59:59", "2013-01-01_00:00:00"},
+	{"0 0 0 1 1 *", "2013-01-01_00:00:00", "2014-01-01_00:00:00"},
+	{"* * * * * *", "2012-12-31_23:59:59", "2013-01-01_00:00:00"},
+	{"59 59 23 31 12 *", "2012-12-31_23:59:59", "2013-12-31_23:59:59"},
+	{"30 * * * * *", "2012-07-01_09:53:00", "2012-07-01_09:53:30"},
+	{"30 * * * * *", "2012-07-01_09:53:50", "2012-07-01_09:54:30"},
+	{"30 * * * * *", "2012-12-31_23:59:30", "2013-01-01_00:00:30"},
+	{"0 0 12 * 6 *", "2012-07-01_00:00:00", "2013-06-01_12:00:00"},
+	{"0 0 12 * 6 *", "2012-06-30_12:00:00", "2013-06-01_12:00:00"},
+	{"*/15 * 1-4 * * *", "2012-07-01_11:28:29", "2012-07-02_01:00:00"},
+	{"*/15 * 1-4 * * *", "2012-07-01_04:59:50", "2012-07-02_01:00:00"},
+	{"0 30 23 30 1/3 ?", "2011-04-30_23:30:00", "2011-07-30_23:30:00"},
+	{"0 0 7 ? * MON-FRI", "2009-09-26_00:42:55", "2009-09-28_07:00:00"},
+	// The day search ends on the same day of a later month
+	{"0 0 12 1,15 JAN-JUN SUN", "2001-01-01_12:00:00", "2001-04-01_12:00:00"},
+	// The 31st does not exist in the next matching month
+	{"53 * 21-22 * 11 *", "2009-03-31_08:16:01", "2009-11-01_21:00:53"},
+};
+
+static const CRON_CASE_t prev_cases[] = {
+	{"0 0 0 31 * *", "2012-05-01_00:00:00", "2012-03-31_00:00:00"},
+	{"0 0 0 31 * *", "2012-03-31_00:00:00", "2012-01-31_00:00:00"},
+	{"0 0 0 30 * *", "2013-03-01_00:00:00", "2013-01-30_00:00:00"},
+	{"0 0 0 29 2 *", "2015-03-01_00:00:00", "2012-02-29_00:00:00"},
+	{"0 0 0 29 2 *", "2012-02-29_00:00:01", "2012-02-29_00:00:00"},
+	{"0 0 0 1 1 *", "2013-01-01_00:00:00", "2012-01-01_00:00:00"},
+	{"0 0 0 1 1 *", "2013-01-01_00:00:01", "2013-01-01_00:00:00"},
+	{"* * * * * *", "2013-01-01_00:00:00", "2012-12-31_23:59:59"},
+	{"59 59 23 31 12 *", "2013-01-01_00:00:00", "2012-12-31_23:59:59"},
+	{"30 * * * * *", "2012-07-01_09:53:00", "2012-07-01_09:52:30"},
+	{"30 * * * * *", "2013-01-01_00:00:10", "2012-12-31_23:59:30"},
+	{"0 0 12 * 6 *", "2012-05-31_00:00:00", "2011-06-30_12:00:00"},
+	{"0 0 12 * 6 *", "2013-01-01_00:00:00", "2012-06-30_12:00:00"},
+	{"*/15 * 1-4 * * *", "2012-07-02_01:00:00", "2012-07-01_04:59:45"},
+	{"0 30 23 30 1/3 ?", "2011-07-30_23:30:00", "2011-04-30_23:30:00"},
+	{"0 0 7 ? * MON-FRI", "2009-09-28_07:00:00", "2009-09-25_07:00:00"},
+	{"0 0 12 1,15 JAN-JUN SUN", "2001-04-01_00:00:00", "1998-03-15_12:00:00"},
+	{"53 * 21-22 * 11 *", "2009-03-31_08:16:01", "2008-11-30_22:59:53"},
+};
+
+// Expressions that must be rejected
+static const char *invalid_expressions[] = {
+	"",
+	"* * * * *",
+	"60 * * * * *",
+	"0 60 * * * *",
+	"0 0 24 * * *",
+	"0 0 0 32 * *",
+	"0 0 0 * 13 *",
+	"0 0 0 * * 8",
+	"0 0 0 * * XYZ",
+	"0 0 0 5-1 * *",
+	"0 0 0 */0 * *",
+};
+
+static time_t parse_date(const char *date) {
+	struct tm tm;
+	memset(&tm, 0, sizeof(tm));
+	if (sscanf(date, "%d-%d-%d_%d:%d:%d", &tm.tm_year, &tm.tm_mon, &tm.tm_mday, &tm.tm_hour, &tm.tm_min, &tm.tm_sec) != 6) return (time_t)-1;
+	tm.tm_year -= 1900;
+	tm.tm_mon -= 1;
+	return timegm(&tm);
+}
+
+static void format_date(time_t date, char *buf, size_t len) {
+	struct tm tm;
+	if (date == (time_t)-1 || gmtime_r(&date, &tm) == NULL) {
+		snprintf(buf, len, "invalid");
+		return;
+	}
+	strftime(buf, len, "%Y-%m-%d_%H:%M:%S", &tm);
+}
+
+static int check(const char *name, time_t (*fn)(cron_expr *, time_t), const CRON_CASE_t *cases, size_t ncases) {
+	int failed = 0;
+	for (size_t i=0;i<ncases;i++) {
+		const CRON_CASE_t *c = &cases[i];
+		cron_expr expr;
+		const char *error = NULL;
+		cron_parse_expr(c->expression, &expr, &error);
+		if (error != NULL) {
+			printf("FAIL %s \"%s\": %s\n", name, c->expression, error);
+			failed++;
+			continue;
+		}
+		time_t result = fn(&expr, parse_date(c->date));
+		if (result != parse_date(c->expected)) {
+			char buf[32];
+			format_date(result, buf, sizeof(buf));
+			printf("FAIL %s \"%s\" from %s: expected %s, got %s\n", name, c->expression, c->date, c->expected, buf);
+			failed++;
+		}
+	}
+	return failed;
+}
+
+int main(void) {
+	int failed = 0;
+	failed += check("cron_next", cron_next, next_cases, sizeof(next_cases)/sizeof(next_cases[0]));
+	failed += check("cron_prev", cron_prev, prev_cases, sizeof(prev_cases)/sizeof(prev_cases[0]));
+
+	for (size_t i=0;i<sizeof(invalid_expressions)/sizeof(invalid_expressions[0]);i++) {
+		cron_expr expr;
+		const char *error = NULL;
+		cron_parse_expr(invalid_expressions[i], &expr, &error);
+		if (error == NULL) {
+			printf("FAIL cron_parse_expr \"%s\" was accepted\n", invalid_expressions[i]);
+			failed++;
+		}
+	}
+
+	printf("%d failed\n", failed);
+	return failed ? 1 : 0;
+}
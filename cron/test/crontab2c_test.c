@@ -0,0 +1,104 @@
+/*
+	Compare crontab2c.py with cron_parse_expr on the host
+
+	This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+	Unless required by applicable law or agreed to in writing, this
+	software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+	CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#include <stdio.h>
+#include <string.h>
+
+#include "ccronexpr.h"
+
+// Same as EMBEDDED_CRON_t in main.c
+typedef struct {
+	cron_expr expr;
+	char taskName[32];
+	char dateTime[64];
+} EMBEDDED_CRON_t;
+
+// Generated from crontab_valid by crontab2c.py
+#include "embedded_crontab.h"
+
+static void dump(const char *label, const cron_expr *expr) {
+	const uint8_t *bytes = (const uint8_t *)expr;
+	printf("  %s", label);
+	for (int i=0;i<sizeof(cron_expr);i++) printf(" %02x", bytes[i]);
+	printf("\n");
+}
+
+// Every expression converted at build time must have the same bits as cron_parse_expr
+static int test_valid(void) {
+	int failed = 0;
+	for (int index=0;index<EMBEDDED_CRONTAB_SIZE;index++) {
+		const char *err = NULL;
+		cron_expr expr;
+		memset(&expr, 0, sizeof(expr));
+		cron_parse_expr(embedded_crontab[index].dateTime, &expr, &err);
+		if (err != NULL) {
+			printf("FAIL [%s] rejected by cron_parse_expr: %s\n", embedded_crontab[index].dateTime, err);
+			failed++;
+		} else if (memcmp(&expr, &embedded_crontab[index].expr, sizeof(cron_expr)) != 0) {
+			printf("FAIL [%s] bits differ\n", embedded_crontab[index].dateTime);
+			dump("crontab2c.py   ", &embedded_crontab[index].expr);
+			dump("cron_parse_expr", &expr);
+			failed++;
+		}
+	}
+	printf("%d valid expressions\n", EMBEDDED_CRONTAB_SIZE);
+	return failed;
+}
+
+// Every expression rejected by crontab2c.py must be rejected by cron_parse_expr
+static int test_invalid(const char *fileName) {
+	FILE *f = fopen(fileName, "r");
+	if (f == NULL) {
+		printf("FAIL can not open %s\n", fileName);
+		return 1;
+	}
+	int failed = 0;
+	int count = 0;
+	char line[256];
+	while (fgets(line, sizeof(line), f) != NULL) {
+		// Same as read_crontab() in crontab2c.py
+		char *items[7];
+		int nitem = 0;
+		for (char *item = strtok(line, " \t\r\n"); item != NULL && nitem < 7; item = strtok(NULL, " \t\r\n")) {
+			items[nitem++] = item;
+		}
+		if (nitem == 0 || items[0][0] == '#') continue;
+		char expression[256] = "";
+		for (int i=0;i<6 && i<nitem;i++) {
+			if (i > 0) strcat(expression, " ");
+			strcat(expression, items[i]);
+		}
+		const char *err = NULL;
+		cron_expr expr;
+		cron_parse_expr(expression, &expr, &err);
+		if (err == NULL) {
+			printf("FAIL [%s] accepted by cron_parse_expr\n", expression);
+			failed++;
+		}
+		count++;
+	}
+	fclose(f);
+	printf("%d invalid expressions\n", count);
+	return failed;
+}
+
+int main(int argc, char *argv[]) {
+	if (argc != 2) {
+		printf("usage: %s crontab_invalid\n", argv[0]);
+		return 2;
+	}
+	int failed = test_valid() + test_invalid(argv[1]);
+	if (failed) {
+		printf("%d failed\n", failed);
+		return 1;
+	}
+	printf("passed\n");
+	return 0;
+}
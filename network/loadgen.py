@@ -0,0 +1,104 @@
+#!/usr/bin/env python3
+#
+# Load generator for the HTTP server.
+# Each client keeps one connection open and sends the requests one after another.
+# Prints the requests per second and the latency percentiles.
+#
+# usage: loadgen.py [-c clients] [-n requests] [-m method] [-p path] [--close] host[:port]
+#
+
+import argparse
+import http.client
+import threading
+import time
+from collections import Counter
+
+
+def percentile(values, percent):
+    if not values:
+        return 0.0
+    index = min(len(values) - 1, int(len(values) * percent / 100))
+    return values[index]
+
+
+def client(args, host, port, count, latencies, statuses, counters, lock):
+    connection = None
+    for _ in range(count):
+        if connection is None:
+            connection = http.client.HTTPConnection(host, port, timeout=args.timeout)
+            with lock:
+                counters["connections"] += 1
+        headers = {"Connection": "close"} if args.close else {}
+        body = args.body.encode() if args.body is not None else None
+        if body is not None:
+            headers["Content-Type"] = "application/json"
+        start = time.perf_counter()
+        try:
+            connection.request(args.method, args.path, body=body, headers=headers)
+            response = connection.getresponse()
+            response.read()
+            status = response.status
+            # The server closes the connection after an error, or when asked to
+            if args.close or response.will_close:
+                connection.close()
+                connection = None
+        except (OSError, http.client.HTTPException) as e:
+            status = type(e).__name__
+            connection.close()
+            connection = None
+        elapsed = time.perf_counter() - start
+        with lock:
+            latencies.append(elapsed)
+            statuses[status] += 1
+    if connection is not None:
+        connection.close()
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Load generator for the HTTP server")
+    parser.add_argument("host", help="host[:port] of the server")
+    parser.add_argument("-c", "--clients", type=int, default=4, help="number of concurrent clients")
+    parser.add_argument("-n", "--requests", type=int, default=200, help="total number of requests")
+    parser.add_argument("-m", "--method", default="GET", help="request method")
+    parser.add_argument("-p", "--path", default="/", help="request path")
+    parser.add_argument("-d", "--body", default=None, help="request body")
+    parser.add_argument("--close", action="store_true", help="open a new connection for each request")
+    parser.add_argument("--timeout", type=float, default=10.0, help="socket timeout in seconds")
+    args = parser.parse_args()
+
+    host, _, port = args.host.partition(":")
+    port = int(port) if port else 8080
+
+    latencies = []
+    statuses = Counter()
+    counters = Counter()
+    lock = threading.Lock()
+    threads = []
+    for index in range(args.clients):
+        # Spread the requests over the clients
+        count = args.requests // args.clients + (1 if index < args.requests % args.clients else 0)
+        thread = threading.Thread(target=client, args=(args, host, port, count, latencies, statuses, counters, lock))
+        threads.append(thread)
+
+    start = time.perf_counter()
+    for thread in threads:
+        thread.start()
+    for thread in threads:
+        thread.join()
+    elapsed = time.perf_counter() - start
+
+    latencies.sort()
+    print(f"{args.method} http://{host}:{port}{args.path}")
+    print(f"clients      {args.clients}")
+    print(f"requests     {len(latencies)} in {elapsed:.2f} s")
+    print(f"connections  {counters['connections']}")
+    print(f"status       " + " ".join(f"{status}:{count}" for status, count in sorted(statuses.items(), key=str)))
+    print(f"throughput   {len(latencies) / elapsed:.1f} requests/s")
+    print("latency ms   min {:.1f} p50 {:.1f} p90 {:.1f} p99 {:.1f} max {:.1f}".format(
+        *(value * 1000 for value in (latencies[0] if latencies else 0, percentile(latencies, 50),
+                                     percentile(latencies, 90), percentile(latencies, 99),
+                                     latencies[-1] if latencies else 0))))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,84 @@
+/*
+	Pool of the buffers for the request bodies
+
+	This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+	Unless required by applicable law or agreed to in writing, this
+	software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+	CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "esp_log.h"
+
+#include "buffer_pool.h"
+
+static const char *TAG = "POOL";
+
+// The buffers of one size are carved out of one block.
+// The queue holds the pointers of the free buffers, so any task can take and give them.
+typedef struct {
+	size_t size;
+	int count;
+	char *block;
+	QueueHandle_t free;
+} POOL_CLASS_t;
+
+// Ordered by the size
+static POOL_CLASS_t s_classes[] = {
+	{ .size = BUFFER_POOL_SMALL },
+	{ .size = BUFFER_POOL_LARGE },
+};
+
+#define NCLASS (sizeof(s_classes) / sizeof(s_classes[0]))
+
+static esp_err_t class_init(POOL_CLASS_t *pool, int count) {
+	pool->count = count;
+	if (count == 0) return ESP_OK;
+	pool->block = malloc(pool->size * count);
+	pool->free = xQueueCreate(count, sizeof(char *));
+	if (pool->block == NULL || pool->free == NULL) {
+		ESP_LOGE(TAG, "Error allocating %d buffers of %d bytes", count, pool->size);
+		return ESP_ERR_NO_MEM;
+	}
+	for (int i=0;i<count;i++) {
+		char *buffer = pool->block + pool->size * i;
+		xQueueSend(pool->free, &buffer, 0);
+	}
+	return ESP_OK;
+}
+
+esp_err_t buffer_pool_init(int nsmall, int nlarge) {
+	esp_err_t err = class_init(&s_classes[0], nsmall);
+	if (err != ESP_OK) return err;
+	err = class_init(&s_classes[1], nlarge);
+	if (err != ESP_OK) return err;
+	ESP_LOGI(TAG, "%d x %d bytes, %d x %d bytes", nsmall, s_classes[0].size, nlarge, s_classes[1].size);
+	return ESP_OK;
+}
+
+char *buffer_pool_take(size_t size) {
+	// A larger buffer is used when all the buffers of the size are in use
+	for (int i=0;i<NCLASS;i++) {
+		POOL_CLASS_t *pool = &s_classes[i];
+		if (pool->size < size || pool->count == 0) continue;
+		char *buffer;
+		if (xQueueReceive(pool->free, &buffer, 0) == pdTRUE) return buffer;
+	}
+	return NULL;
+}
+
+void buffer_pool_give(char *buffer) {
+	if (buffer == NULL) return;
+	for (int i=0;i<NCLASS;i++) {
+		POOL_CLASS_t *pool = &s_classes[i];
+		if (pool->count == 0) continue;
+		if (buffer < pool->block || buffer >= pool->block + pool->size * pool->count) continue;
+		xQueueSend(pool->free, &buffer, 0);
+		return;
+	}
+	ESP_LOGE(TAG, "%p is not a buffer of the pool", buffer);
+}
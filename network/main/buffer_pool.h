@@ -0,0 +1,20 @@
+#ifndef BUFFER_POOL_H
+#define BUFFER_POOL_H
+
+#include <stddef.h>
+#include "esp_err.h"
+
+#define BUFFER_POOL_SMALL 128
+#define BUFFER_POOL_LARGE 1024
+
+// Allocate all the buffers. nsmall buffers of BUFFER_POOL_SMALL bytes and nlarge buffers of BUFFER_POOL_LARGE bytes.
+esp_err_t buffer_pool_init(int nsmall, int nlarge);
+
+// Take the smallest free buffer of at least size bytes without waiting.
+// Returns NULL when the size is too large or all the buffers are in use.
+char *buffer_pool_take(size_t size);
+
+// Return the buffer taken by buffer_pool_take
+void buffer_pool_give(char *buffer);
+
+#endif /* BUFFER_POOL_H */
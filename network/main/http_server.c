@@ -11,21 +11,106 @@
 #include <stdio.h>
 #include <inttypes.h>
 #include <string.h>
+#include <stdlib.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/queue.h"
 #include "esp_log.h"
 #include "esp_err.h"
-#include "esp_vfs.h"
+#include "esp_idf_version.h"
 #include "esp_http_server.h"
 
+#include "transmitter.h"
+#include "channel.h"
+#include "batch.h"
+#include "buffer_pool.h"
+
 static const char *TAG = "HTTP";
 
-#define SCRATCH_BUFSIZE (1024)
+// Number of the buffers for the bodies longer than BUFFER_POOL_SMALL
+#define LARGE_BUFFERS 2
+
+// Number of the batches running or waiting for the batch task
+#define BATCH_SLOTS 2
+
+// The handlers return ESP_OK after an error response, so the connection is kept alive.
+// ESP_FAIL closes the socket and is returned only when the connection is broken.
+
+// Wait time to queue the command to the RF transmitter
+#define TX_QUEUE_WAIT_MS 1000
+
+// Number of the receive timeouts (recv_wait_timeout each) before giving up on a stalled client
+#define RECEIVE_TIMEOUT_RETRY 3
+
+// The asynchronous requests are available from ESP-IDF V5.1
+#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 1, 0)
+#define HTTP_ASYNC 1
+#endif
+
+#if HTTP_ASYNC
+// Request waiting for the RF transmitter. Taken from the buffer pool.
+typedef struct {
+	httpd_req_t *req;
+	char path[64];
+} ASYNC_REQUEST_t;
+
+_Static_assert(sizeof(ASYNC_REQUEST_t) <= BUFFER_POOL_SMALL, "ASYNC_REQUEST_t must fit in a small buffer");
+
+// Results of the commands sent by the asynchronous requests
+static QueueHandle_t s_done_queue = NULL;
+
+// Batch waiting for the batch task
+typedef struct {
+	httpd_req_t *req;
+	BATCH_t *batch;
+} BATCH_JOB_t;
+
+static QueueHandle_t s_batch_queue = NULL;
+#endif
+
+// The batches are allocated at startup. The queue holds the pointers of the free ones.
+static BATCH_t s_batches[BATCH_SLOTS];
+static QueueHandle_t s_free_batches = NULL;
+
+static BATCH_t *batch_take(void)
+{
+	BATCH_t *batch;
+	if (xQueueReceive(s_free_batches, &batch, 0) != pdTRUE) return NULL;
+	return batch;
+}
+
+static void batch_give(BATCH_t *batch)
+{
+	xQueueSend(s_free_batches, &batch, 0);
+}
+
+// Respond with the result of the RF transmitter
+static void send_result(httpd_req_t *req, const char *path, const TX_RESULT_t *result)
+{
+	char resp[192];
+	snprintf(resp, sizeof(resp), "{\"path\":\"%s\",\"status\":\"%s\",\"replaced\":%s,\"wait_us\":%"PRIu32",\"air_us\":%"PRIu32"}\n",
+		path, esp_err_to_name(result->status), result->replaced ? "true" : "false", result->wait_us, result->air_us);
+	ESP_LOGI(TAG, "%.*s", (int)strlen(resp)-1, resp);
+	if (result->status != ESP_OK) httpd_resp_set_status(req, HTTPD_500);
+	httpd_resp_set_type(req, HTTPD_TYPE_JSON);
+	httpd_resp_sendstr(req, resp);
+}
 
-typedef struct rest_server_context {
-	char base_path[ESP_VFS_PATH_MAX + 1]; // Not used in this project
-	char scratch[SCRATCH_BUFSIZE];
-} rest_server_context_t;
+#if HTTP_ASYNC
+// Respond to the asynchronous requests as the RF transmitter completes them
+static void async_response_task(void *pvParameters)
+{
+	TX_RESULT_t result;
+	while(1) {
+		xQueueReceive(s_done_queue, &result, portMAX_DELAY);
+		ASYNC_REQUEST_t *async = result.context;
+		send_result(async->req, async->path, &result);
+		httpd_req_async_handler_complete(async->req);
+		buffer_pool_give((char *)async);
+	}
+	vTaskDelete(NULL);
+}
+#endif
 
 
 /* Handler for root get */
@@ -39,93 +124,280 @@ static esp_err_t root_get_handler(httpd_req_t *req)
 	return ESP_OK;
 }
 
-/* Handler for on */
-static esp_err_t switch_on_handler(httpd_req_t *req)
+// Read the body into a buffer of the pool.
+// Returns NULL after responding with the error, and status is what the handler returns then.
+static char *receive_body(httpd_req_t *req, esp_err_t *status)
 {
-	ESP_LOGI(__FUNCTION__, "req->uri=[%s] req->content_len=%d", req->uri, req->content_len);
+	*status = ESP_OK;
 	int total_len = req->content_len;
 	int cur_len = 0;
-	char *buf = ((rest_server_context_t *)(req->user_ctx))->scratch;
 	int received = 0;
-	if (total_len >= SCRATCH_BUFSIZE) {
-		/* Respond with 500 Internal Server Error */
-		httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "content too long");
-		return ESP_FAIL;
+	if (total_len >= BUFFER_POOL_LARGE) {
+		httpd_resp_set_status(req, "413 Payload Too Large");
+		httpd_resp_sendstr(req, "content too long");
+		return NULL;
+	}
+	// Each request has its own buffer, so the requests of the other sockets do not overwrite it
+	char *buf = buffer_pool_take(total_len + 1);
+	if (buf == NULL) {
+		httpd_resp_set_status(req, "503 Service Unavailable");
+		httpd_resp_sendstr(req, "Server busy");
+		return NULL;
 	}
+	int timeouts = 0;
 	while (cur_len < total_len) {
-		received = httpd_req_recv(req, buf + cur_len, total_len);
+		received = httpd_req_recv(req, buf + cur_len, total_len - cur_len);
+		if (received == HTTPD_SOCK_ERR_TIMEOUT && ++timeouts < RECEIVE_TIMEOUT_RETRY) continue;
+		if (received == HTTPD_SOCK_ERR_TIMEOUT) {
+			buffer_pool_give(buf);
+			ESP_LOGW(TAG, "Timeout receiving %d of %d bytes", cur_len, total_len);
+			httpd_resp_send_err(req, HTTPD_408_REQ_TIMEOUT, "Timeout receiving the body");
+			// The client has stalled
+			*status = ESP_FAIL;
+			return NULL;
+		}
 		if (received <= 0) {
+			buffer_pool_give(buf);
 			/* Respond with 500 Internal Server Error */
 			httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Failed to post control value");
-			return ESP_FAIL;
+			// The connection is broken
+			*status = ESP_FAIL;
+			return NULL;
 		}
 		cur_len += received;
 	}
 	buf[total_len] = '\0';
-	ESP_LOGI(__FUNCTION__, "buf=[%s]", buf);
+	return buf;
+}
+
+// Run the batch and respond with the summary
+static void send_batch(httpd_req_t *req, BATCH_t *batch)
+{
+	batch_run(batch);
+	esp_err_t status = ESP_OK;
+	for (int index=0;index<batch->count;index++) {
+		if (batch->results[index].status != ESP_OK) status = ESP_FAIL;
+	}
+	char *summary = batch_summary(batch);
+	batch_give(batch);
+	if (summary == NULL) {
+		httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "No memory for summary");
+		return;
+	}
+	ESP_LOGI(TAG, "%s", summary);
+	if (status != ESP_OK) httpd_resp_set_status(req, HTTPD_500);
+	httpd_resp_set_type(req, HTTPD_TYPE_JSON);
+	httpd_resp_sendstr(req, summary);
+	free(summary);
+}
 
-	httpd_resp_sendstr(req, "on successfully\n");
+#if HTTP_ASYNC
+// Run the batches one by one, so the httpd task is not blocked for the whole batch
+static void batch_task(void *pvParameters)
+{
+	BATCH_JOB_t job;
+	while(1) {
+		xQueueReceive(s_batch_queue, &job, portMAX_DELAY);
+		send_batch(job.req, job.batch);
+		httpd_req_async_handler_complete(job.req);
+	}
+	vTaskDelete(NULL);
+}
+#endif
 
-	TaskHandle_t taskHandle = xTaskGetHandle("task_on");
-	ESP_LOGI(TAG, "taskHandle=%"PRIu32, (uint32_t)taskHandle);
-	xTaskNotifyGive(taskHandle);
+/* Handler for /api/batch */
+static esp_err_t batch_handler(httpd_req_t *req)
+{
+	ESP_LOGI(__FUNCTION__, "req->uri=[%s] req->content_len=%d", req->uri, req->content_len);
+	esp_err_t status;
+	char *buf = receive_body(req, &status);
+	if (buf == NULL) return status;
+	BATCH_t *batch = batch_take();
+	if (batch == NULL) {
+		buffer_pool_give(buf);
+		httpd_resp_set_status(req, "503 Service Unavailable");
+		httpd_resp_sendstr(req, "Server busy");
+		return ESP_OK;
+	}
+	status = batch_parse(buf, batch);
+	buffer_pool_give(buf);
+	if (status != ESP_OK) {
+		char resp[64];
+		snprintf(resp, sizeof(resp), "operation %d: %s", batch->failed, esp_err_to_name(status));
+		batch_give(batch);
+		if (status == ESP_ERR_NOT_FOUND) {
+			httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, resp);
+		} else if (status == ESP_ERR_INVALID_STATE) {
+			httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, resp);
+		} else {
+			httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, resp);
+		}
+		return ESP_OK;
+	}
 
+#if HTTP_ASYNC
+	BATCH_JOB_t job = { .batch = batch };
+	if (httpd_req_async_handler_begin(req, &job.req) != ESP_OK) {
+		batch_give(batch);
+		/* Respond with 500 Internal Server Error */
+		httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Failed to start async request");
+		return ESP_OK;
+	}
+	if (xQueueSend(s_batch_queue, &job, 0) != pdTRUE) {
+		batch_give(batch);
+		httpd_resp_set_status(job.req, "503 Service Unavailable");
+		httpd_resp_sendstr(job.req, "Server busy");
+		httpd_req_async_handler_complete(job.req);
+	}
+	return ESP_OK;
+#else
+	send_batch(req, batch);
 	return ESP_OK;
+#endif
 }
 
-/* Handler for off */
-static esp_err_t switch_off_handler(httpd_req_t *req)
+/* Handler for /api/<channel>/<state>. /api/on and /api/off are for the channel 0. */
+static esp_err_t switch_handler(httpd_req_t *req)
 {
 	ESP_LOGI(__FUNCTION__, "req->uri=[%s] req->content_len=%d", req->uri, req->content_len);
-	int total_len = req->content_len;
-	int cur_len = 0;
-	char *buf = ((rest_server_context_t *)(req->user_ctx))->scratch;
-	int received = 0;
-	if (total_len >= SCRATCH_BUFSIZE) {
+	esp_err_t status;
+	char *buf = receive_body(req, &status);
+	if (buf == NULL) return status;
+	ESP_LOGI(__FUNCTION__, "buf=[%s]", buf);
+	buffer_pool_give(buf);
+
+	// Channel and state following /api/
+	char path[64];
+	strlcpy(path, req->uri + strlen("/api/"), sizeof(path));
+	char *query = strchr(path, '?');
+	if (query != NULL) *query = '\0';
+	TX_COMMAND_t command;
+	status = channel_command(path, &command);
+	if (status == ESP_ERR_NOT_FOUND) {
+		httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, "No such channel");
+		return ESP_OK;
+	}
+	if (status == ESP_ERR_INVALID_ARG) {
+		httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid repeats");
+		return ESP_OK;
+	}
+	if (status != ESP_OK) {
 		/* Respond with 500 Internal Server Error */
-		httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "content too long");
-		return ESP_FAIL;
+		httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Channel has not been taught");
+		return ESP_OK;
 	}
-	while (cur_len < total_len) {
-		received = httpd_req_recv(req, buf + cur_len, total_len);
-		if (received <= 0) {
-			/* Respond with 500 Internal Server Error */
-			httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Failed to post control value");
-			return ESP_FAIL;
+
+	// ?repeats=N overrides the number of times to repeat the frame
+	char query_str[32];
+	char value[8];
+	if (httpd_req_get_url_query_str(req, query_str, sizeof(query_str)) == ESP_OK &&
+		httpd_query_key_value(query_str, "repeats", value, sizeof(value)) == ESP_OK) {
+		int repeats = atoi(value);
+		if (repeats < 1 || repeats > CHANNEL_REPEATS_MAX) {
+			httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid repeats");
+			return ESP_OK;
 		}
-		cur_len += received;
+		command.repeats = repeats;
 	}
-	buf[total_len] = '\0';
-	ESP_LOGI(__FUNCTION__, "buf=[%s]", buf);
-
-	httpd_resp_sendstr(req, "off successfully\n");
-
-	TaskHandle_t taskHandle = xTaskGetHandle("task_off");
-	ESP_LOGI(TAG, "taskHandle=%"PRIu32, (uint32_t)taskHandle);
-	xTaskNotifyGive(taskHandle);
 
+#if HTTP_ASYNC
+	// Respond after the RF frame has been sent.
+	// The response task answers, so the server keeps serving the other sockets while the RF is busy.
+	ASYNC_REQUEST_t *async = (ASYNC_REQUEST_t *)buffer_pool_take(sizeof(ASYNC_REQUEST_t));
+	if (async == NULL) {
+		httpd_resp_set_status(req, "503 Service Unavailable");
+		httpd_resp_sendstr(req, "Server busy");
+		return ESP_OK;
+	}
+	strcpy(async->path, path);
+	if (httpd_req_async_handler_begin(req, &async->req) != ESP_OK) {
+		buffer_pool_give((char *)async);
+		/* Respond with 500 Internal Server Error */
+		httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Failed to start async request");
+		return ESP_OK;
+	}
+	command.reply = s_done_queue;
+	command.context = async;
+	status = transmitter_send(&command, pdMS_TO_TICKS(TX_QUEUE_WAIT_MS));
+	if (status != ESP_OK) {
+		TX_RESULT_t result = { .status = status };
+		send_result(async->req, path, &result);
+		httpd_req_async_handler_complete(async->req);
+		buffer_pool_give((char *)async);
+	}
 	return ESP_OK;
+#else
+	// Respond after the RF frame has been sent
+	TX_RESULT_t result;
+	transmitter_send_wait(&command, pdMS_TO_TICKS(TX_QUEUE_WAIT_MS), &result);
+	send_result(req, path, &result);
+	return ESP_OK;
+#endif
 }
 
 /* favicon get handler */
 static esp_err_t favicon_get_handler(httpd_req_t *req)
 {
 	ESP_LOGI(__FUNCTION__, "favicon_get_handler req->uri=[%s]", req->uri);
+	// No icon. Respond anyway, so the browser does not wait on the connection.
+	httpd_resp_set_status(req, "204 No Content");
+	httpd_resp_send(req, NULL, 0);
 	return ESP_OK;
 }
 
 /* Function to start the file server */
 esp_err_t start_server(int port)
 {
-	rest_server_context_t *rest_context = calloc(1, sizeof(rest_server_context_t));
-	if (rest_context == NULL) {
-		ESP_LOGE(__FUNCTION__, "No memory for rest context");
-		while(1) { vTaskDelay(1); }
+	// One small buffer for each socket
+	if (buffer_pool_init(CONFIG_HTTP_MAX_OPEN_SOCKETS, LARGE_BUFFERS) != ESP_OK) {
+		return ESP_ERR_NO_MEM;
+	}
+
+	s_free_batches = xQueueCreate(BATCH_SLOTS, sizeof(BATCH_t *));
+	if (s_free_batches == NULL) {
+		ESP_LOGE(__FUNCTION__, "xQueueCreate fail");
+		return ESP_ERR_NO_MEM;
+	}
+	for (int i=0;i<BATCH_SLOTS;i++) batch_give(&s_batches[i]);
+
+#if HTTP_ASYNC
+	// Each request waiting for the RF transmitter holds a pooled buffer,
+	// so the queue has room for a result from every buffer of the pool
+	s_done_queue = xQueueCreate(CONFIG_HTTP_MAX_OPEN_SOCKETS + LARGE_BUFFERS, sizeof(TX_RESULT_t));
+	if (s_done_queue == NULL) {
+		ESP_LOGE(__FUNCTION__, "xQueueCreate fail");
+		return ESP_ERR_NO_MEM;
+	}
+	if (xTaskCreate(async_response_task, "HTTP_TX", 1024*3, NULL, 2, NULL) != pdPASS) {
+		ESP_LOGE(__FUNCTION__, "xTaskCreate fail");
+		return ESP_ERR_NO_MEM;
+	}
+	// Every batch taken can wait in the queue
+	s_batch_queue = xQueueCreate(BATCH_SLOTS, sizeof(BATCH_JOB_t));
+	if (s_batch_queue == NULL) {
+		ESP_LOGE(__FUNCTION__, "xQueueCreate fail");
+		return ESP_ERR_NO_MEM;
+	}
+	if (xTaskCreate(batch_task, "BATCH", 1024*4, NULL, 2, NULL) != pdPASS) {
+		ESP_LOGE(__FUNCTION__, "xTaskCreate fail");
+		return ESP_ERR_NO_MEM;
 	}
+#endif
 
 	httpd_handle_t server = NULL;
 	httpd_config_t config = HTTPD_DEFAULT_CONFIG();
 	config.server_port = port;
+	config.max_open_sockets = CONFIG_HTTP_MAX_OPEN_SOCKETS;
+	config.backlog_conn = CONFIG_HTTP_BACKLOG;
+	config.stack_size = CONFIG_HTTP_STACK_SIZE;
+	config.core_id = CONFIG_HTTP_CORE_ID < 0 ? tskNO_AFFINITY : CONFIG_HTTP_CORE_ID;
+	// Close the least recently used socket instead of refusing a new client
+	config.lru_purge_enable = true;
+#if CONFIG_HTTP_KEEP_ALIVE
+	// Detect the clients which disappeared without closing the connection
+	config.keep_alive_enable = true;
+	config.keep_alive_idle = CONFIG_HTTP_KEEP_ALIVE_IDLE;
+#endif
 
 	/* Use the URI wildcard matching function in order to
 	 * allow the same handler to respond to multiple different
@@ -147,23 +419,21 @@ esp_err_t start_server(int port)
 	};
 	httpd_register_uri_handler(server, &root);
 
-	/* URI handler for on */
-	httpd_uri_t switch_on_uri = {
-		.uri		 = "/api/on",
+	/* URI handler for /api/batch. Registered before the wildcard which would match it too. */
+	httpd_uri_t batch_uri = {
+		.uri		 = "/api/batch",
 		.method		 = HTTP_POST,
-		.handler	 = switch_on_handler, 
-		.user_ctx	 = rest_context
+		.handler	 = batch_handler,
 	};
-	httpd_register_uri_handler(server, &switch_on_uri);
+	httpd_register_uri_handler(server, &batch_uri);
 
-	/* URI handler for off */
-	httpd_uri_t switch_off_uri = {
-		.uri		 = "/api/off",
+	/* URI handler for /api/<channel>/<state> */
+	httpd_uri_t switch_uri = {
+		.uri		 = "/api/*",
 		.method		 = HTTP_POST,
-		.handler	 = switch_off_handler, 
-		.user_ctx	 = rest_context
+		.handler	 = switch_handler,
 	};
-	httpd_register_uri_handler(server, &switch_off_uri);
+	httpd_register_uri_handler(server, &switch_uri);
 
 	/* URI handler for favicon.ico */
 	httpd_uri_t _favicon_get_handler = {
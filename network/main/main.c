@@ -23,7 +23,8 @@
 #include "nvs_flash.h"
 #include "netdb.h" // ipaddr_addr
 
-#include "RCSwitch.h"
+#include "transmitter.h"
+#include "channel.h"
 
 /* FreeRTOS event group to signal when we are connected*/
 static EventGroupHandle_t s_wifi_event_group;
@@ -182,120 +183,6 @@ void http_server(void *pvParameters);
 void mqtt(void *pvParameters);
 #endif
 
-// Turn on USB
-void task_on(void *pvParameters) {
-	ESP_LOGI(pcTaskGetName(NULL), "%"PRIu32" Start", (uint32_t)xTaskGetCurrentTaskHandle());
-
-	// Open NVS
-	nvs_handle_t my_handle;
-	esp_err_t err = nvs_open("storage", NVS_READWRITE, &my_handle);
-	if (err != ESP_OK) {
-		ESP_LOGE(pcTaskGetName(NULL), "nvs_open error (%s)", esp_err_to_name(err));
-		vTaskDelete(NULL);
-	}
-
-	// Read NVS
-	uint32_t ValueOn = 0;
-	uint16_t BitlengthOn = 0;
-	uint16_t ProtocolOn = 0;
-
-	err = nvs_get_u32(my_handle, "ValueOn", &ValueOn);
-	if (err != ESP_OK) {
-		ESP_LOGE(pcTaskGetName(NULL), "ValueOn get failed");
-		vTaskDelete(NULL);
-	}
-	ESP_LOGI(pcTaskGetName(NULL), "ValueOn=%lu", ValueOn);
-
-	err = nvs_get_u16(my_handle, "BitlengthOn", &BitlengthOn);
-	if (err != ESP_OK) {
-		ESP_LOGE(pcTaskGetName(NULL), "BitlengthOn get failed");
-		vTaskDelete(NULL);
-	}
-	ESP_LOGI(pcTaskGetName(NULL), "BitlengthOn=%u", BitlengthOn);
-
-	err = nvs_get_u16(my_handle, "ProtocolOn", &ProtocolOn);
-	if (err != ESP_OK) {
-		ESP_LOGE(pcTaskGetName(NULL), "ProtocolOn get failed");
-		vTaskDelete(NULL);
-	}
-	ESP_LOGI(pcTaskGetName(NULL), "ProtocolOn=%u", ProtocolOn);
-
-	// Close NVS
-	nvs_close(my_handle);
-
-	// Initialize RF
-	RCSWITCH_t RCSwitch;
-	initSwich(&RCSwitch);
-	enableTransmit(&RCSwitch, CONFIG_RF_GPIO);
-	setRepeatTransmit(&RCSwitch, 10);
-
-	while(1) {
-		ulTaskNotifyTake( pdTRUE, portMAX_DELAY );
-		ESP_LOGI(pcTaskGetName(NULL), "Wake Up");
-		setProtocol(&RCSwitch, ProtocolOn);
-		sendCode(&RCSwitch, ValueOn, BitlengthOn);
-		ESP_LOGD(pcTaskGetName(NULL), "Wait for Notify");
-	}
-	vTaskDelete(NULL);
-}
-
-// Turn off USB
-void task_off(void *pvParameters) {
-	ESP_LOGI(pcTaskGetName(NULL), "%"PRIu32" Start", (uint32_t)xTaskGetCurrentTaskHandle());
-
-	// Open NVS
-	nvs_handle_t my_handle;
-	esp_err_t err = nvs_open("storage", NVS_READWRITE, &my_handle);
-	if (err != ESP_OK) {
-		ESP_LOGE(pcTaskGetName(NULL), "nvs_open error (%s)", esp_err_to_name(err));
-		vTaskDelete(NULL);
-	}
-
-	// Read NVS
-	uint32_t ValueOff = 0;
-	uint16_t BitlengthOff = 0;
-	uint16_t ProtocolOff = 0;
-
-	err = nvs_get_u32(my_handle, "ValueOff", &ValueOff);
-	if (err != ESP_OK) {
-		ESP_LOGE(pcTaskGetName(NULL), "ValueOff get failed");
-		vTaskDelete(NULL);
-	}
-	ESP_LOGI(pcTaskGetName(NULL), "ValueOff=%lu", ValueOff);
-
-	err = nvs_get_u16(my_handle, "BitlengthOff", &BitlengthOff);
-	if (err != ESP_OK) {
-		ESP_LOGE(pcTaskGetName(NULL), "BitlengthOff get failed");
-		vTaskDelete(NULL);
-	}
-	ESP_LOGI(pcTaskGetName(NULL), "BitlengthOff=%u", BitlengthOff);
-
-	err = nvs_get_u16(my_handle, "ProtocolOff", &ProtocolOff);
-	if (err != ESP_OK) {
-		ESP_LOGE(pcTaskGetName(NULL), "ProtocolOff get failed");
-		vTaskDelete(NULL);
-	}
-	ESP_LOGI(pcTaskGetName(NULL), "ProtocolOff=%u", ProtocolOff);
-
-	// Close NVS
-	nvs_close(my_handle);
-
-	// Initialize RF
-	RCSWITCH_t RCSwitch;
-	initSwich(&RCSwitch);
-	enableTransmit(&RCSwitch, CONFIG_RF_GPIO);
-	setRepeatTransmit(&RCSwitch, 10);
-
-	while(1) {
-		ulTaskNotifyTake( pdTRUE, portMAX_DELAY );
-		ESP_LOGI(pcTaskGetName(NULL), "Wake Up");
-		setProtocol(&RCSwitch, ProtocolOff);
-		sendCode(&RCSwitch, ValueOff, BitlengthOff);
-		ESP_LOGD(pcTaskGetName(NULL), "Wait for Notify");
-	}
-	vTaskDelete(NULL);
-}
-
 void app_main()
 {
 	// Initialize NVS
@@ -312,6 +199,10 @@ void app_main()
 	// Initialize mDNS
 	initialise_mdns();
 
+	// Start RF transmitter
+	ESP_ERROR_CHECK(channel_init());
+	ESP_ERROR_CHECK(transmitter_start(CONFIG_RF_GPIO));
+
 #if CONFIG_NETWORK_HTTP
 	/* Get the local IP address */
 	esp_netif_ip_info_t ip_info;
@@ -327,9 +218,6 @@ void app_main()
 	xTaskCreate(mqtt, "MQTT", 1024*4, NULL, 2, NULL);
 #endif
 
-	// Start task
-	xTaskCreate(task_on, "task_on", 1024*4, NULL, 2, NULL);
-	xTaskCreate(task_off, "task_off", 1024*4, NULL, 2, NULL);
 
 	while(1) {
 		vTaskDelay(10);
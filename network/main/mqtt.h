@@ -1,9 +1,10 @@
+// Event passed from the event handler to the MQTT task
 typedef struct {
-	TaskHandle_t taskHandle;
 	int32_t event_id;
 	int topic_len;
 	char topic[64];
 	int data_len;
 	char data[64];
+	char *batch; // Payload of the batch topic in a buffer of the pool, otherwise NULL
 } MQTT_t;
 
@@ -11,31 +11,73 @@
 #include <stdio.h>
 #include <inttypes.h>
 #include <string.h>
+#include <stdlib.h>
+#include <ctype.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/queue.h"
 #include "esp_log.h"
 #include "esp_mac.h"
 #include "mdns.h"
 #include "mqtt_client.h"
 
 #include "mqtt.h"
+#include "transmitter.h"
+#include "channel.h"
+#include "batch.h"
+#include "buffer_pool.h"
 
 static const char *TAG = "MQTT";
 
+// Number of events waiting for the MQTT task
+#define MQTT_QUEUE_LENGTH 4
+
+// Number of batches waiting for the batch task
+#define MQTT_BATCH_QUEUE_LENGTH 2
+
+// Number of batch payloads waiting for the MQTT task
+#define MQTT_BATCH_BUFFERS 2
+
+// The summary of a batch is published to <base topic>batch/result
+#define MQTT_BATCH_RESULT "batch/result"
+
+static esp_mqtt_client_handle_t s_mqtt_client = NULL;
+static QueueHandle_t s_batch_queue = NULL;
+static char s_result_topic[64];
+
+// Each event is copied into the queue, so a burst of messages is not overwritten
+static void mqtt_event_send(QueueHandle_t mqttQueue, const MQTT_t *mqttBuf)
+{
+	if (xQueueSend(mqttQueue, mqttBuf, 0) != pdTRUE) {
+		ESP_LOGE(TAG, "MQTT queue is full. event_id=%"PRIi32" is dropped", mqttBuf->event_id);
+		buffer_pool_give(mqttBuf->batch);
+	}
+}
+
+// <base topic>batch. The topic of the event is not terminated.
+static bool is_batch_topic(const char *topic, int topic_len)
+{
+	int base_topic_len = strlen(CONFIG_MQTT_SUB_TOPIC)-1;
+	return topic_len == base_topic_len + 5
+		&& memcmp(topic, CONFIG_MQTT_SUB_TOPIC, base_topic_len) == 0
+		&& memcmp(topic + base_topic_len, "batch", 5) == 0;
+}
+
 static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_t event_id, void *event_data)
 {
 	esp_mqtt_event_handle_t event = event_data;
-	MQTT_t *mqttBuf = handler_args;
-	ESP_LOGI(TAG, "taskHandle=0x%x", (unsigned int)mqttBuf->taskHandle);
-	mqttBuf->event_id = event->event_id;
+	QueueHandle_t mqttQueue = handler_args;
+	MQTT_t mqttBuf;
+	mqttBuf.event_id = event->event_id;
+	mqttBuf.batch = NULL;
 	switch (event->event_id) {
 		case MQTT_EVENT_CONNECTED:
 			ESP_LOGI(__FUNCTION__, "MQTT_EVENT_CONNECTED");
-			xTaskNotifyGive( mqttBuf->taskHandle );
+			mqtt_event_send(mqttQueue, &mqttBuf);
 			break;
 		case MQTT_EVENT_DISCONNECTED:
 			ESP_LOGI(__FUNCTION__, "MQTT_EVENT_DISCONNECTED");
-			xTaskNotifyGive( mqttBuf->taskHandle );
+			mqtt_event_send(mqttQueue, &mqttBuf);
 			break;
 		case MQTT_EVENT_SUBSCRIBED:
 			ESP_LOGI(__FUNCTION__, "MQTT_EVENT_SUBSCRIBED, msg_id=%d", event->msg_id);
@@ -50,21 +92,39 @@ static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_
 			ESP_LOGD(__FUNCTION__, "MQTT_EVENT_DATA");
 			ESP_LOGD(__FUNCTION__, "TOPIC=[%.*s] DATA=[%.*s]\r", event->topic_len, event->topic, event->data_len, event->data);
 
-			mqttBuf->topic_len = event->topic_len;
-			for(int i=0;i<event->topic_len;i++) {
-				mqttBuf->topic[i] = event->topic[i];
-				mqttBuf->topic[i+1] = 0;
+			// A message longer than the buffer of the client comes in pieces, the later ones without the topic
+			if (event->data_len != event->total_data_len) {
+				ESP_LOGE(__FUNCTION__, "Fragmented message (%d of %d bytes) is dropped", event->data_len, event->total_data_len);
+				break;
+			}
+			if (event->topic_len >= sizeof(mqttBuf.topic)) {
+				ESP_LOGE(__FUNCTION__, "TOPIC is too long");
+				break;
 			}
-			mqttBuf->data_len = event->data_len;
-			for(int i=0;i<event->data_len;i++) {
-				mqttBuf->data[i] = event->data[i];
-				mqttBuf->data[i+1] = 0;
+			// Only a batch needs more than the small buffer in the event
+			char *data = mqttBuf.data;
+			if (is_batch_topic(event->topic, event->topic_len)) {
+				mqttBuf.batch = buffer_pool_take(event->data_len + 1);
+				if (mqttBuf.batch == NULL) {
+					ESP_LOGE(__FUNCTION__, "No buffer for batch of %d bytes", event->data_len);
+					break;
+				}
+				data = mqttBuf.batch;
+			} else if (event->data_len >= sizeof(mqttBuf.data)) {
+				ESP_LOGE(__FUNCTION__, "DATA is too long");
+				break;
 			}
-			xTaskNotifyGive( mqttBuf->taskHandle );
+			mqttBuf.topic_len = event->topic_len;
+			memcpy(mqttBuf.topic, event->topic, event->topic_len);
+			mqttBuf.topic[event->topic_len] = 0;
+			mqttBuf.data_len = event->data_len;
+			memcpy(data, event->data, event->data_len);
+			data[event->data_len] = 0;
+			mqtt_event_send(mqttQueue, &mqttBuf);
 			break;
 		case MQTT_EVENT_ERROR:
 			ESP_LOGI(__FUNCTION__, "MQTT_EVENT_ERROR");
-			xTaskNotifyGive( mqttBuf->taskHandle );
+			mqtt_event_send(mqttQueue, &mqttBuf);
 			break;
 		default:
 			ESP_LOGI(__FUNCTION__, "Other event id:%d", event->event_id);
@@ -120,6 +180,68 @@ void convert_mdns_host(char * from, char * to)
 }
 
 
+// The payload is the number of times to repeat the frame only when it is all digits.
+// Returns -1 when the payload is not a number, so the channel or the default number is used.
+static int payload_repeats(const char *data, int data_len)
+{
+	if (data_len == 0) return -1;
+	for (int i=0;i<data_len;i++) {
+		if (!isdigit((unsigned char)data[i])) return -1;
+	}
+	// Longer numbers are out of range anyway
+	if (data_len > 3) return CHANNEL_REPEATS_MAX + 1;
+	return atoi(data);
+}
+
+static void publish_result(const char *text)
+{
+	ESP_LOGI(TAG, "%s", text);
+	if (esp_mqtt_client_publish(s_mqtt_client, s_result_topic, text, 0, 0, 0) < 0) {
+		ESP_LOGE(TAG, "Failed to publish to %s", s_result_topic);
+	}
+}
+
+// Run the batches one by one, so the MQTT task keeps receiving the events meanwhile
+static void batch_task(void *pvParameters)
+{
+	BATCH_t *batch;
+	while(1) {
+		xQueueReceive(s_batch_queue, &batch, portMAX_DELAY);
+		batch_run(batch);
+		char *summary = batch_summary(batch);
+		free(batch);
+		if (summary == NULL) {
+			ESP_LOGE(TAG, "No memory for summary");
+			continue;
+		}
+		publish_result(summary);
+		free(summary);
+	}
+	vTaskDelete(NULL);
+}
+
+// The payload is the list of the operations
+static void queue_batch(const char *json)
+{
+	char error[80];
+	BATCH_t *batch = malloc(sizeof(BATCH_t));
+	if (batch == NULL) {
+		publish_result("{\"error\":\"No memory for batch\"}");
+		return;
+	}
+	esp_err_t status = batch_parse(json, batch);
+	if (status != ESP_OK) {
+		snprintf(error, sizeof(error), "{\"error\":\"operation %d: %s\"}", batch->failed, esp_err_to_name(status));
+		free(batch);
+		publish_result(error);
+		return;
+	}
+	if (xQueueSend(s_batch_queue, &batch, 0) != pdTRUE) {
+		free(batch);
+		publish_result("{\"error\":\"busy\"}");
+	}
+}
+
 void mqtt(void *pvParameters)
 {
 	ESP_LOGI(TAG, "start CONFIG_MQTT_BROKER=[%s]", CONFIG_MQTT_BROKER);
@@ -143,10 +265,18 @@ void mqtt(void *pvParameters)
 	sprintf(uri, "mqtt://%s", ip);
 	ESP_LOGI(TAG, "uri=[%s]", uri);
 
+	// Buffers for the batch payloads, so a message on the other topics stays small
+	if (buffer_pool_init(0, MQTT_BATCH_BUFFERS) != ESP_OK) {
+		ESP_LOGE(TAG, "buffer_pool_init fail");
+		vTaskDelete(NULL);
+	}
+
 	// Initialize user context
-	MQTT_t mqttBuf;
-	mqttBuf.taskHandle = xTaskGetCurrentTaskHandle();
-	ESP_LOGI(TAG, "taskHandle=0x%x", (unsigned int)mqttBuf.taskHandle);
+	QueueHandle_t mqttQueue = xQueueCreate(MQTT_QUEUE_LENGTH, sizeof(MQTT_t));
+	if (mqttQueue == NULL) {
+		ESP_LOGE(TAG, "xQueueCreate fail");
+		vTaskDelete(NULL);
+	}
 	esp_mqtt_client_config_t mqtt_cfg = {
 		.broker.address.uri = uri,
 		.broker.address.port = 1883,
@@ -154,7 +284,7 @@ void mqtt(void *pvParameters)
 	};
 
 	esp_mqtt_client_handle_t mqtt_client = esp_mqtt_client_init(&mqtt_cfg);
-	esp_mqtt_client_register_event(mqtt_client, ESP_EVENT_ANY_ID, mqtt_event_handler, &mqttBuf);
+	esp_mqtt_client_register_event(mqtt_client, ESP_EVENT_ANY_ID, mqtt_event_handler, mqttQueue);
 	esp_mqtt_client_start(mqtt_client);
 
 	// Get base topic (/api/hd44780/puts --> /api/hd44780/)
@@ -165,9 +295,24 @@ void mqtt(void *pvParameters)
 	base_topic[base_topic_len] = 0;
 	ESP_LOGI(TAG, "base_topic=[%s]", base_topic);
 
+	// The batches run in their own task
+	s_mqtt_client = mqtt_client;
+	snprintf(s_result_topic, sizeof(s_result_topic), "%s%s", base_topic, MQTT_BATCH_RESULT);
+	ESP_LOGI(TAG, "result_topic=[%s]", s_result_topic);
+	s_batch_queue = xQueueCreate(MQTT_BATCH_QUEUE_LENGTH, sizeof(BATCH_t *));
+	if (s_batch_queue == NULL) {
+		ESP_LOGE(TAG, "xQueueCreate fail");
+		vTaskDelete(NULL);
+	}
+	if (xTaskCreate(batch_task, "MQTT_BATCH", 1024*4, NULL, 2, NULL) != pdPASS) {
+		ESP_LOGE(TAG, "xTaskCreate fail");
+		vTaskDelete(NULL);
+	}
+
+	MQTT_t mqttBuf;
 	while (1) {
-		ulTaskNotifyTake( pdTRUE, portMAX_DELAY );
-		ESP_LOGD(TAG, "ulTaskNotifyTake");
+		xQueueReceive(mqttQueue, &mqttBuf, portMAX_DELAY);
+		ESP_LOGD(TAG, "xQueueReceive");
 		ESP_LOGI(TAG, "event_id=%"PRIi32, mqttBuf.event_id);
 
 		if (mqttBuf.event_id == MQTT_EVENT_CONNECTED) {
@@ -177,18 +322,37 @@ void mqtt(void *pvParameters)
 			break;
 		} else if (mqttBuf.event_id == MQTT_EVENT_DATA) {
 			ESP_LOGI(TAG, "TOPIC=[%.*s]\r", mqttBuf.topic_len, mqttBuf.topic);
-			ESP_LOGI(TAG, "DATA=[%.*s]\r", mqttBuf.data_len, mqttBuf.data);
+			ESP_LOGI(TAG, "DATA=[%.*s]\r", mqttBuf.data_len, mqttBuf.batch != NULL ? mqttBuf.batch : mqttBuf.data);
 			char bottom_topic[64];
 			strcpy(bottom_topic, &mqttBuf.topic[base_topic_len]);
 			ESP_LOGI(TAG, "bottom_topic=[%s]", bottom_topic);
-			if (strcmp(bottom_topic, "on") == 0) {
-				TaskHandle_t taskHandle = xTaskGetHandle("task_on");
-				ESP_LOGI(TAG, "taskHandle=%"PRIu32, (uint32_t)taskHandle);
-				xTaskNotifyGive(taskHandle);
-			} else if (strcmp(bottom_topic, "off") == 0) {
-				TaskHandle_t taskHandle = xTaskGetHandle("task_off");
-				ESP_LOGI(TAG, "taskHandle=%"PRIu32, (uint32_t)taskHandle);
-				xTaskNotifyGive(taskHandle);
+			if (mqttBuf.batch != NULL) {
+				// batch_parse copies the operations, so the buffer goes back at once
+				queue_batch(mqttBuf.batch);
+				buffer_pool_give(mqttBuf.batch);
+				continue;
+			}
+			// Our own summary comes back through the subscription
+			if (strcmp(bottom_topic, MQTT_BATCH_RESULT) == 0) continue;
+			// <channel>/<state>. on and off are for the channel 0.
+			TX_COMMAND_t command;
+			esp_err_t status = channel_command(bottom_topic, &command);
+			int repeats = payload_repeats(mqttBuf.data, mqttBuf.data_len);
+			if (status == ESP_OK && repeats >= 0) {
+				// A number in the payload overrides the number of times to repeat the frame
+				if (repeats < 1 || repeats > CHANNEL_REPEATS_MAX) {
+					status = ESP_ERR_INVALID_ARG;
+				} else {
+					ESP_LOGI(TAG, "[%s] repeats=%d", bottom_topic, repeats);
+					command.repeats = repeats;
+				}
+			}
+			if (status == ESP_OK) {
+				// Do not wait for the completion, so the transmitter can coalesce a burst of messages
+				status = transmitter_send(&command, portMAX_DELAY);
+			}
+			if (status != ESP_OK) {
+				ESP_LOGE(TAG, "[%s] fail (%s)", bottom_topic, esp_err_to_name(status));
 			}
 		} else if (mqttBuf.event_id == MQTT_EVENT_ERROR) {
 			ESP_LOGE(TAG, "MQTT_EVENT_ERROR");
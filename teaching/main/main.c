@@ -1,4 +1,5 @@
 #include <stdio.h>
+#include <inttypes.h>
 #include <math.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
@@ -6,126 +7,171 @@
 #include "nvs_flash.h"
 #include "esp_log.h"
 
-#include "RCSwitch.h"
+#include "receiver.h"
+#include "channel.h"
 
 static const char *TAG = "MAIN";
 
-void app_main()
-{
-	// Initialize NVS
-	esp_err_t err = nvs_flash_init();
-	if (err == ESP_ERR_NVS_NO_FREE_PAGES || err == ESP_ERR_NVS_NEW_VERSION_FOUND) {
-		// NVS partition was truncated and needs to be erased
-		// Retry nvs_flash_init
-		ESP_ERROR_CHECK(nvs_flash_erase());
-		err = nvs_flash_init();
-	}
-	ESP_ERROR_CHECK( err );
-
-	ESP_LOGI(TAG, "Start receiver");
-	RCSWITCH_t RCSwitch;
-	initSwich(&RCSwitch);
-	enableReceive(&RCSwitch, CONFIG_RF_GPIO);
-
-	ESP_LOGW(TAG, "Press the ON switch");
-	unsigned long ValueOn = 0;
-	unsigned int BitlengthOn = 0;
-	unsigned int ProtocolOn = 0;
-	while(1) {
-		if (available(&RCSwitch)) {
-			ValueOn = getReceivedValue(&RCSwitch);
-			BitlengthOn = getReceivedBitlength(&RCSwitch);
-			ProtocolOn = getReceivedProtocol(&RCSwitch);
-			ESP_LOGI(TAG, "Received %lu / %dbit Protocol: %d", ValueOn, BitlengthOn, ProtocolOn);
-			resetAvailable(&RCSwitch);
-			break;
-		} else {
-			vTaskDelay(1);
+#if CONFIG_TEACH_MODE_RAW
+typedef struct {
+	RF_RAW_CODE_t raw;
+	int count;
+} RAW_VOTE_t;
+
+// Collect the raw frames of one press and return the frame most of them agree on
+static bool collect_raw_frames(RF_RAW_CODE_t *result) {
+	static RAW_VOTE_t votes[CONFIG_TEACH_FRAMES];
+	int nvote = 0;
+	int nframe = 0;
+	RF_RAW_CODE_t raw;
+
+	// Wait for the press, then take the frames until the button is released
+	TickType_t wait = portMAX_DELAY;
+	while (nframe < CONFIG_TEACH_FRAMES && receiver_receive_raw(&raw, wait) == ESP_OK) {
+		ESP_LOGI(TAG, "Received %d durations / %d levels", raw.count, raw.nlevel);
+		wait = pdMS_TO_TICKS(CONFIG_TEACH_FRAME_TIMEOUT);
+		nframe++;
+		int i;
+		for (i=0;i<nvote;i++) {
+			if (rfcodec_raw_equal(&votes[i].raw, &raw)) break;
 		}
-	} // end while
-
-	// Clear RF
-	for (int i=0;i<100;i++) {
-		if (available(&RCSwitch)) {
-			getReceivedValue(&RCSwitch);
-			resetAvailable(&RCSwitch);
-		} else {
-			vTaskDelay(1);
+		if (i == nvote) {
+			votes[nvote].raw = raw;
+			votes[nvote].count = 0;
+			nvote++;
 		}
+		votes[i].count++;
 	}
 
-	ESP_LOGW(TAG, "Press the OFF switch");
-	unsigned long ValueOff = 0;
-	unsigned int BitlengthOff = 0;
-	unsigned int ProtocolOff = 0;
-	while(1) {
-		if (available(&RCSwitch)) {
-			ValueOff = getReceivedValue(&RCSwitch);
-			BitlengthOff = getReceivedBitlength(&RCSwitch);
-			ProtocolOff = getReceivedProtocol(&RCSwitch);
-			ESP_LOGI(TAG, "Received %lu / %dbit Protocol: %d", ValueOff, BitlengthOff, ProtocolOff);
-			resetAvailable(&RCSwitch);
-			break;
-		} else {
-			vTaskDelay(1);
-		}
-	} // end while
-
-	// Open NVS
-	nvs_handle_t my_handle;
-	err = nvs_open("storage", NVS_READWRITE, &my_handle);
-	if (err != ESP_OK) {
-		ESP_LOGE(TAG, "nvs_open error (%s)", esp_err_to_name(err));
-		vTaskDelete(NULL);
+	int best = 0;
+	for (int i=1;i<nvote;i++) {
+		if (votes[i].count > votes[best].count) best = i;
+	}
+	if (nvote == 0 || votes[best].count < CONFIG_TEACH_AGREEMENT) {
+		ESP_LOGE(TAG, "Only %d of %d frames agree", nvote ? votes[best].count : 0, nframe);
+		return false;
 	}
+	*result = votes[best].raw;
+	return true;
+}
 
-	// Set NVS
-	err = nvs_set_u32(my_handle, "ValueOn", ValueOn);
-	if (err != ESP_OK) {
-		ESP_LOGE(TAG, "ValueOn set failed");
-		vTaskDelete(NULL);
+// Teach one button until enough frames agree
+static esp_err_t teach_button(const char *name, int state) {
+	RF_RAW_CODE_t raw;
+	while(1) {
+		ESP_LOGW(TAG, "Press the %s switch", name);
+		receiver_flush();
+		if (collect_raw_frames(&raw)) break;
+		ESP_LOGW(TAG, "Hold the %s switch a little longer", name);
 	}
+	ESP_LOGI(TAG, "%s: %d durations / %d levels", name, raw.count, raw.nlevel);
 
-	err = nvs_set_u16(my_handle, "BitlengthOn", BitlengthOn);
-	if (err != ESP_OK) {
-		ESP_LOGE(TAG, "BitlengthOn set failed");
-		vTaskDelete(NULL);
+	// Discard the rest of the burst until the RF is quiet
+	RF_RAW_CODE_t frame;
+	while (receiver_receive_raw(&frame, pdMS_TO_TICKS(1000)) == ESP_OK) { }
+	return channel_set_raw(CONFIG_TEACH_CHANNEL, CONFIG_TEACH_CHANNEL_NAME, state, &raw);
+}
+
+#else
+typedef struct {
+	RF_FRAME_t frame;
+	int count;
+	uint32_t pulse_sum;
+} VOTE_t;
+
+// Collect the frames of one press and return the frame most of them agree on
+static bool collect_frames(RF_FRAME_t *result) {
+	VOTE_t votes[CONFIG_TEACH_FRAMES];
+	int nvote = 0;
+	int nframe = 0;
+	RF_FRAME_t frame;
+
+	// Wait for the press, then take the frames until the button is released
+	TickType_t wait = portMAX_DELAY;
+	while (nframe < CONFIG_TEACH_FRAMES && receiver_receive(&frame, wait) == ESP_OK) {
+		ESP_LOGI(TAG, "Received %"PRIu32" / %dbit Protocol: %d Pulse: %dus", frame.code, frame.bitlength, frame.protocol, frame.pulse_length);
+		wait = pdMS_TO_TICKS(CONFIG_TEACH_FRAME_TIMEOUT);
+		nframe++;
+		int i;
+		for (i=0;i<nvote;i++) {
+			if (votes[i].frame.code == frame.code && votes[i].frame.bitlength == frame.bitlength && votes[i].frame.protocol == frame.protocol) break;
+		}
+		if (i == nvote) {
+			votes[nvote].frame = frame;
+			votes[nvote].count = 0;
+			votes[nvote].pulse_sum = 0;
+			nvote++;
+		}
+		votes[i].count++;
+		votes[i].pulse_sum += frame.pulse_length;
 	}
 
-	err = nvs_set_u16(my_handle, "ProtocolOn", ProtocolOn);
-	if (err != ESP_OK) {
-		ESP_LOGE(TAG, "ProtocolOn set failed");
-		vTaskDelete(NULL);
+	int best = 0;
+	for (int i=1;i<nvote;i++) {
+		if (votes[i].count > votes[best].count) best = i;
 	}
+	if (nvote == 0 || votes[best].count < CONFIG_TEACH_AGREEMENT) {
+		ESP_LOGE(TAG, "Only %d of %d frames agree", nvote ? votes[best].count : 0, nframe);
+		return false;
+	}
+	*result = votes[best].frame;
+	result->pulse_length = votes[best].pulse_sum / votes[best].count;
+	return true;
+}
 
-	err = nvs_set_u32(my_handle, "ValueOff", ValueOff);
-	if (err != ESP_OK) {
-		ESP_LOGE(TAG, "ValueOff set failed");
-		vTaskDelete(NULL);
+// Teach one button until enough frames agree
+static esp_err_t teach_button(const char *name, int state) {
+	RF_FRAME_t result;
+	while(1) {
+		ESP_LOGW(TAG, "Press the %s switch", name);
+		receiver_flush();
+		if (collect_frames(&result)) break;
+		ESP_LOGW(TAG, "Hold the %s switch a little longer", name);
 	}
+	ESP_LOGI(TAG, "%s: %"PRIu32" / %dbit Protocol: %d Pulse: %dus", name, result.code, result.bitlength, result.protocol, result.pulse_length);
 
-	err = nvs_set_u16(my_handle, "BitlengthOff", BitlengthOff);
-	if (err != ESP_OK) {
-		ESP_LOGE(TAG, "BitlengthOff set failed");
-		vTaskDelete(NULL);
+	// Discard the rest of the burst until the RF is quiet
+	RF_FRAME_t frame;
+	while (receiver_receive(&frame, pdMS_TO_TICKS(1000)) == ESP_OK) { }
+	return channel_set(CONFIG_TEACH_CHANNEL, CONFIG_TEACH_CHANNEL_NAME, state, result.code, result.bitlength, result.protocol, result.pulse_length);
+}
+#endif
+
+void app_main()
+{
+	// Initialize NVS
+	esp_err_t err = nvs_flash_init();
+	if (err == ESP_ERR_NVS_NO_FREE_PAGES || err == ESP_ERR_NVS_NEW_VERSION_FOUND) {
+		// NVS partition was truncated and needs to be erased
+		// Retry nvs_flash_init
+		ESP_ERROR_CHECK(nvs_flash_erase());
+		err = nvs_flash_init();
 	}
+	ESP_ERROR_CHECK( err );
+
+	ESP_LOGI(TAG, "Start receiver");
+	ESP_ERROR_CHECK(receiver_start(CONFIG_RF_GPIO));
 
-	err = nvs_set_u16(my_handle, "ProtocolOff", ProtocolOff);
+	// Keep the codes of the other channels
+	ESP_ERROR_CHECK(channel_init());
+	err = teach_button("ON", CHANNEL_ON);
+	if (err == ESP_OK) {
+		err = teach_button("OFF", CHANNEL_OFF);
+	}
+	if (err == ESP_OK) {
+		err = channel_set_repeats(CONFIG_TEACH_CHANNEL, CONFIG_TEACH_REPEATS);
+	}
 	if (err != ESP_OK) {
-		ESP_LOGE(TAG, "ProtocolOff set failed");
+		ESP_LOGE(TAG, "channel_set failed (%s)", esp_err_to_name(err));
 		vTaskDelete(NULL);
 	}
 
-	// Commit written value.
-	// After setting any values, nvs_commit() must be called to ensure changes are written
-	// to flash storage. Implementations may write to storage at other times,
-	// but this is not guaranteed.
-	err = nvs_commit(my_handle);
+	// Write the channel table to NVS
+	err = channel_save();
 	if (err != ESP_OK) {
-		ESP_LOGE(TAG, "nvs_commit failed");
+		ESP_LOGE(TAG, "channel_save failed");
 		vTaskDelete(NULL);
 	}
-
-	// Close NVS
-	nvs_close(my_handle);
+	CHANNEL_t *channel = channel_get(CONFIG_TEACH_CHANNEL);
+	ESP_LOGI(TAG, "Channel %d [%s] has been taught", CONFIG_TEACH_CHANNEL, channel->name);
 }
@@ -16,10 +16,35 @@
 #include "nvs_flash.h"
 #include "esp_log.h"
 
-#include "RCSwitch.h"
+#include "transmitter.h"
+#include "channel.h"
 
 static const char *TAG = "MAIN";
 
+// Commands resolved once at startup
+static TX_COMMAND_t s_command[2];
+
+static esp_err_t build_command(const char *state, TX_COMMAND_t *command) {
+	char path[32];
+	snprintf(path, sizeof(path), "%s/%s", CONFIG_TIMER_CHANNEL, state);
+	esp_err_t err = channel_command(path, command);
+	if (err != ESP_OK) {
+		ESP_LOGE(TAG, "[%s] fail (%s)", path, esp_err_to_name(err));
+		return err;
+	}
+	// The timer fires often, so it sends fewer frames than the default of the transmitter
+	if (command->repeats == 0) command->repeats = CONFIG_TIMER_REPEATS;
+	return ESP_OK;
+}
+
+// Send the state of the channel and wait for the completion
+static void send_state(int state) {
+	esp_err_t err = transmitter_send_wait(&s_command[state], portMAX_DELAY, NULL);
+	if (err != ESP_OK) {
+		ESP_LOGE(TAG, "transmitter_send_wait fail (%s)", esp_err_to_name(err));
+	}
+}
+
 void app_main()
 {
 	// Initialize NVS
@@ -32,107 +57,44 @@ void app_main()
 	}
 	ESP_ERROR_CHECK( err );
 
-	// Open NVS
-	nvs_handle_t my_handle;
-	err = nvs_open("storage", NVS_READWRITE, &my_handle);
-	if (err != ESP_OK) {
-		ESP_LOGE(TAG, "nvs_open error (%s)", esp_err_to_name(err));
-		vTaskDelete(NULL);
-	}
-
-	// Read NVS
-	uint32_t ValueOn = 0;
-	uint16_t BitlengthOn = 0;
-	uint16_t ProtocolOn = 0;
-	uint32_t ValueOff = 0;
-	uint16_t BitlengthOff = 0;
-	uint16_t ProtocolOff = 0;
-
-	err = nvs_get_u32(my_handle, "ValueOn", &ValueOn);
-	if (err != ESP_OK) {
-		ESP_LOGE(TAG, "ValueOn get failed");
-		vTaskDelete(NULL);
-	}
-	ESP_LOGI(TAG, "ValueOn=%lu", ValueOn);
-
-	err = nvs_get_u16(my_handle, "BitlengthOn", &BitlengthOn);
-	if (err != ESP_OK) {
-		ESP_LOGE(TAG, "BitlengthOn get failed");
-		vTaskDelete(NULL);
-	}
-	ESP_LOGI(TAG, "BitlengthOn=%u", BitlengthOn);
-
-	err = nvs_get_u16(my_handle, "ProtocolOn", &ProtocolOn);
-	if (err != ESP_OK) {
-		ESP_LOGE(TAG, "ProtocolOn get failed");
-		vTaskDelete(NULL);
-	}
-	ESP_LOGI(TAG, "ProtocolOn=%u", ProtocolOn);
-
-	err = nvs_get_u32(my_handle, "ValueOff", &ValueOff);
-	if (err != ESP_OK) {
-		ESP_LOGE(TAG, "ValueOff get failed");
+	// Read the codes taught by the teaching app
+	ESP_ERROR_CHECK(channel_init());
+	if (build_command("on", &s_command[CHANNEL_ON]) != ESP_OK || build_command("off", &s_command[CHANNEL_OFF]) != ESP_OK) {
+		ESP_LOGE(TAG, "Channel [%s] has not been taught", CONFIG_TIMER_CHANNEL);
 		vTaskDelete(NULL);
 	}
-	ESP_LOGI(TAG, "ValueOff=%lu", ValueOff);
-
-	err = nvs_get_u16(my_handle, "BitlengthOff", &BitlengthOff);
-	if (err != ESP_OK) {
-		ESP_LOGE(TAG, "BitlengthOff get failed");
-		vTaskDelete(NULL);
-	}
-	ESP_LOGI(TAG, "BitlengthOff=%u", BitlengthOff);
-
-	err = nvs_get_u16(my_handle, "ProtocolOff", &ProtocolOff);
-	if (err != ESP_OK) {
-		ESP_LOGE(TAG, "ProtocolOff get failed");
-		vTaskDelete(NULL);
-	}
-	ESP_LOGI(TAG, "ProtocolOff=%u", ProtocolOff);
-
-	// Close NVS
-	nvs_close(my_handle);
 
-	// Initialize RF
-	RCSWITCH_t RCSwitch;
-	initSwich(&RCSwitch);
-	enableTransmit(&RCSwitch, CONFIG_RF_GPIO);
-	setRepeatTransmit(&RCSwitch, 3);
+	// Start RF transmitter
+	ESP_ERROR_CHECK(transmitter_start(CONFIG_RF_GPIO));
 
 	int32_t interval_to_off = CONFIG_INTERVAL_TO_OFF * 1000;
 	int32_t interval_to_on = CONFIG_INTERVAL_TO_ON * 1000;
 
 #if CONFIG_INITIAL_STATE_ON
 	ESP_LOGI(TAG, "USB ON");
-	setProtocol(&RCSwitch, ProtocolOn);
-	sendCode(&RCSwitch, ValueOn, BitlengthOn);
+	send_state(CHANNEL_ON);
 	vTaskDelay(pdMS_TO_TICKS(interval_to_off));
 
 	while(1) {
 		ESP_LOGI(TAG, "USB OFF");
-		setProtocol(&RCSwitch, ProtocolOff);
-		sendCode(&RCSwitch, ValueOff, BitlengthOff);
+		send_state(CHANNEL_OFF);
 		vTaskDelay(pdMS_TO_TICKS(interval_to_on));
 		ESP_LOGI(TAG, "USB ON");
-		setProtocol(&RCSwitch, ProtocolOn);
-		sendCode(&RCSwitch, ValueOn, BitlengthOn);
+		send_state(CHANNEL_ON);
 		vTaskDelay(pdMS_TO_TICKS(interval_to_off));
 	} // end while
 
 #elif CONFIG_INITIAL_STATE_OFF
 	ESP_LOGI(TAG, "USB OFF");
-	setProtocol(&RCSwitch, ProtocolOff);
-	sendCode(&RCSwitch, ValueOff, BitlengthOff);
+	send_state(CHANNEL_OFF);
 	vTaskDelay(pdMS_TO_TICKS(interval_to_on));
 
 	while(1) {
 		ESP_LOGI(TAG, "USB ON");
-		setProtocol(&RCSwitch, ProtocolOn);
-		sendCode(&RCSwitch, ValueOn, BitlengthOn);
+		send_state(CHANNEL_ON);
 		vTaskDelay(pdMS_TO_TICKS(interval_to_off));
 		ESP_LOGI(TAG, "USB OFF");
-		setProtocol(&RCSwitch, ProtocolOff);
-		sendCode(&RCSwitch, ValueOff, BitlengthOff);
+		send_state(CHANNEL_OFF);
 		vTaskDelay(pdMS_TO_TICKS(interval_to_on));
 	} // end while
 #endif